@@ -0,0 +1,133 @@
+// Benchmark each stage of bvg with Google Benchmark on synthetic
+// populations: counting the bits different between two bitvectors,
+// finding all relations, sorting them, finding the spanning graph
+// with each engine, and orienting it into a genealogy.
+//
+// A synthetic population of count bitvectors of bits bits is grown
+// by the Generator behind 'bvg --generate', so the benchmarks measure
+// the same shape of data that --generate writes.  Populations are
+// drawn from a fixed seed, so every run measures the same work.
+//
+// Run 'make bench' to build and run the benchmarks, and pass Google
+// Benchmark's own options, such as --benchmark_filter=<regex>, to
+// bvg-bench to run only some.
+
+#define BVG_BENCH
+#include "bvg.cc"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+
+// Return a synthetic population of count bitvectors of bits bits
+// grown with percentage, by packing what Generator grows in memory.
+//
+static unique_ptr<Population> synthesize(size_t count, size_t bits,
+                                         int percentage)
+{
+  BitVector::mutationPercentage = percentage;
+  Generator generator(count, bits, count * 1000003 + bits * 101 + percentage);
+  ostringstream genes;
+  generator.write(genes, 0, true);
+  const string packed(genes.str());
+  vector<uint64_t> words(count * BitVector::stride);
+  memcpy(&words[0], packed.data() + sizeof(PackedHeader),
+         words.size() * sizeof(uint64_t));
+  return unique_ptr<Population>(new Population(bits, count, words));
+}
+
+// The bits different between two bitvectors of range(0) bits.
+//
+static void BM_Distance(benchmark::State &state)
+{
+  const unique_ptr<Population> p(synthesize(2, state.range(0), 20));
+  const BitVector &lhs = p->bitVectors[0], &rhs = p->bitVectors[1];
+  for (auto _ : state) benchmark::DoNotOptimize(lhs - rhs);
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * 2 * BitVector::stride * 8);
+}
+BENCHMARK(BM_Distance)->RangeMultiplier(10)->Range(100, 100000);
+
+// All the relations of range(0) bitvectors of range(1) bits.
+//
+static void BM_FindAll(benchmark::State &state)
+{
+  const unique_ptr<Population> p(synthesize(state.range(0), state.range(1),
+                                            20));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SpanningGraph::findAll<Relation>(*p));
+  }
+  const size_t count = state.range(0);
+  state.SetItemsProcessed(state.iterations() * count * (count - 1) / 2);
+}
+BENCHMARK(BM_FindAll)->ArgsProduct({{500, 2000}, {100, 1000, 10000}})
+  ->Unit(benchmark::kMillisecond);
+
+// Sorting the relations of range(0) bitvectors of range(1) bits with
+// mutation percentage range(2), by counting if range(3) is 0, or else
+// with std::sort().
+//
+static void BM_Sort(benchmark::State &state)
+{
+  const unique_ptr<Population> p(synthesize(state.range(0), state.range(1),
+                                            state.range(2)));
+  const vector<Relation> relations(SpanningGraph::findAll<Relation>(*p));
+  SpanningGraph::sorter = state.range(3)
+    ? SpanningGraph::STANDARD : SpanningGraph::COUNTING;
+  state.SetLabel(state.range(3) ? "std" : "counting");
+  for (auto _ : state) {
+    state.PauseTiming();
+    vector<Relation> sorted(relations);
+    state.ResumeTiming();
+    SpanningGraph::sortAll(sorted);
+    benchmark::DoNotOptimize(sorted.data());
+  }
+  SpanningGraph::sorter = SpanningGraph::COUNTING;
+  state.SetItemsProcessed(state.iterations() * relations.size());
+}
+BENCHMARK(BM_Sort)
+  ->ArgsProduct({{500, 2000}, {1000, 10000}, {5, 20}, {0, 1}})
+  ->Unit(benchmark::kMillisecond);
+
+// Finding the spanning graph of range(1) bitvectors of range(2) bits
+// with mutation percentage range(3) with engine range(0).
+//
+static void BM_SpanningGraph(benchmark::State &state)
+{
+  static const char *const names[] = {
+    "kruskal", "prim", "lazy", "approx", "boruvka"
+  };
+  const SpanningGraph::Engine engine = SpanningGraph::Engine(state.range(0));
+  const unique_ptr<Population> p(synthesize(state.range(1), state.range(2),
+                                            state.range(3)));
+  state.SetLabel(names[engine]);
+  for (auto _ : state) {
+    const SpanningGraph graph(*p, engine);
+    benchmark::DoNotOptimize(graph.result.edges.data());
+  }
+}
+BENCHMARK(BM_SpanningGraph)
+  ->ArgsProduct({{SpanningGraph::KRUSKAL, SpanningGraph::PRIM,
+                  SpanningGraph::LAZY, SpanningGraph::APPROXIMATE,
+                  SpanningGraph::BORUVKA},
+                 {500, 2000}, {1000, 10000}, {5, 20}})
+  ->Unit(benchmark::kMillisecond);
+
+// Orienting the spanning graph of range(0) bitvectors of 1000 bits
+// with mutation percentage 20 into a genealogy.
+//
+static void BM_Genealogy(benchmark::State &state)
+{
+  const unique_ptr<Population> p(synthesize(state.range(0), 1000, 20));
+  const SpanningGraph graph(*p, SpanningGraph::LAZY);
+  for (auto _ : state) {
+    const Genealogy genealogy(graph.result);
+    benchmark::DoNotOptimize(genealogy.result.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Genealogy)->RangeMultiplier(4)->Range(1000, 16000)
+  ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+// Find the closest relations of Boruvka rounds on a CUDA device.
+//
+// The bits of the population are copied to the device once, word
+// major, so that word k of bitvector i is at k * count + i and
+// neighboring threads, which take neighboring bitvectors, read
+// neighboring words.  Each block of threads finds the closest
+// relations of QUERIES bitvectors at once, so each word read serves
+// QUERIES counts, and reduces them across its threads to one key per
+// bitvector.  Only the keys come back: nothing the size of the
+// distance matrix is ever stored on either side.
+
+#include "bvg-gpu.h"
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+
+namespace {
+
+// The bitvectors each block finds the closest relations of, the
+// threads in each block, and the most bitvectors in each batch.
+//
+const int QUERIES = 8;
+const int THREADS = 256;
+const size_t BATCH = 1 << 16;
+
+// The device memory behind a Device.
+//
+struct State
+{
+  uint64_t *bits;
+  int *subgraph;
+  int *wanted;
+  unsigned long long *keys;
+  size_t count, stride;
+
+  // Free whatever has been allocated.
+  //
+  void release() {
+    cudaFree(bits); cudaFree(subgraph); cudaFree(wanted); cudaFree(keys);
+    bits = 0; subgraph = 0; wanted = 0; keys = 0;
+  }
+
+  State(size_t c, size_t s):
+    bits(0), subgraph(0), wanted(0), keys(0), count(c), stride(s)
+  {}
+};
+
+// Set keys[n] to the closest relation of bitvector wanted[n] for the
+// QUERIES wanted bitvectors of this block, as Device::closest() says.
+//
+__global__ void findClosest(const uint64_t *bits, int count, int stride,
+                            const int *subgraph, const int *wanted, int wants,
+                            unsigned expected, unsigned long long *keys)
+{
+  __shared__ unsigned long long least[QUERIES][THREADS / 32];
+  const int first = blockIdx.x * QUERIES;
+  int query[QUERIES], group[QUERIES];
+  unsigned long long best[QUERIES];
+  for (int q = 0; q < QUERIES; ++q) {
+    query[q] = first + q < wants ? wanted[first + q] : -1;
+    group[q] = query[q] < 0 ? -1 : subgraph[query[q]];
+    best[q] = ~0ULL;
+  }
+  for (int i = threadIdx.x; i < count; i += blockDim.x) {
+    unsigned counts[QUERIES] = {};
+    for (int k = 0; k < stride; ++k) {
+      const uint64_t *const word = bits + size_t(k) * count;
+      const uint64_t w = word[i];
+      for (int q = 0; q < QUERIES; ++q) {
+        if (query[q] >= 0) counts[q] += __popcll(w ^ __ldg(word + query[q]));
+      }
+    }
+    const int g = subgraph[i];
+    for (int q = 0; q < QUERIES; ++q) {
+      if (query[q] >= 0 && g != group[q]) {
+        const unsigned c = counts[q];
+        const unsigned nbd = c > expected ? c - expected : expected - c;
+        const unsigned long long key = (unsigned long long)(nbd) << 32 | i;
+        if (key < best[q]) best[q] = key;
+      }
+    }
+  }
+  for (int q = 0; q < QUERIES; ++q) {
+    unsigned long long b = best[q];
+    for (int offset = 16; offset > 0; offset /= 2) {
+      const unsigned long long other = __shfl_down_sync(0xffffffff, b, offset);
+      if (other < b) b = other;
+    }
+    if (threadIdx.x % 32 == 0) least[q][threadIdx.x / 32] = b;
+  }
+  __syncthreads();
+  if (threadIdx.x < QUERIES && first + int(threadIdx.x) < wants) {
+    unsigned long long b = ~0ULL;
+    for (int n = 0; n < THREADS / 32; ++n) {
+      if (least[threadIdx.x][n] < b) b = least[threadIdx.x][n];
+    }
+    keys[first + threadIdx.x] = b;
+  }
+}
+
+}
+
+
+bool Device::closest(const int *subgraph, const int *wanted, size_t wants,
+                     size_t expected, uint64_t *keys)
+{
+  State &s = *static_cast<State *>(state);
+  const size_t ints = s.count * sizeof(int);
+  if (cudaMemcpy(s.subgraph, subgraph, ints, cudaMemcpyHostToDevice)) {
+    return false;
+  }
+  for (size_t begin = 0; begin < wants; begin += BATCH) {
+    const size_t batch = min(BATCH, wants - begin);
+    if (cudaMemcpy(s.wanted, wanted + begin, batch * sizeof(int),
+                   cudaMemcpyHostToDevice)) {
+      return false;
+    }
+    const int blocks = (batch + QUERIES - 1) / QUERIES;
+    findClosest<<<blocks, THREADS>>>(s.bits, s.count, s.stride, s.subgraph,
+                                     s.wanted, batch, expected, s.keys);
+    if (cudaGetLastError()
+        || cudaMemcpy(keys + begin, s.keys, batch * sizeof(uint64_t),
+                      cudaMemcpyDeviceToHost)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Device::Device(const uint64_t *bits, size_t count, size_t stride): state(0)
+{
+  if (count == 0 || count >= size_t(1) << 31) return;
+  int devices = 0;
+  if (cudaGetDeviceCount(&devices) || devices == 0) return;
+  vector<uint64_t> words(count * stride);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t k = 0; k < stride; ++k) {
+      words[k * count + i] = bits[i * stride + k];
+    }
+  }
+  State *const s = new State(count, stride);
+  const size_t batch = min(BATCH, count);
+  if (cudaMalloc(&s->bits, words.size() * sizeof(uint64_t))
+      || cudaMalloc(&s->subgraph, count * sizeof(int))
+      || cudaMalloc(&s->wanted, batch * sizeof(int))
+      || cudaMalloc(&s->keys, batch * sizeof(unsigned long long))
+      || cudaMemcpy(s->bits, &words[0], words.size() * sizeof(uint64_t),
+                    cudaMemcpyHostToDevice)) {
+    s->release();
+    delete s;
+    return;
+  }
+  state = s;
+}
+
+Device::~Device()
+{
+  State *const s = static_cast<State *>(state);
+  if (s) s->release();
+  delete s;
+}
@@ -0,0 +1,41 @@
+// The interface between bvg.cc and bvg-gpu.cu, which finds the
+// closest relations of the boruvka engine on a CUDA device when bvg
+// is built as bvg-gpu.
+
+#ifndef BVG_GPU_H
+#define BVG_GPU_H
+
+#include <cstddef>
+#include <cstdint>
+
+
+// The count bitvectors of stride words each at bits, copied to the
+// first CUDA device.  *this is false if there is no device, or the
+// bitvectors do not fit in its memory.
+//
+struct Device
+{
+  void *state;
+
+  operator bool() const { return state != 0; }
+
+  // For each of the wants bitvectors n listed in wanted, set keys to
+  // the least of nbd << 32 | i over the bitvectors i where subgraph[i]
+  // is not subgraph[n], and nbd is the count of bits different between
+  // n and i normalized to expected.  When every bitvector is in the
+  // same subgraph as n, set its key to all ones.  The keys are found
+  // in batches, so the device holds only a batch of them at a time.
+  // Return false if the device fails.
+  //
+  bool closest(const int *subgraph, const int *wanted, size_t wants,
+               size_t expected, uint64_t *keys);
+
+  Device(const uint64_t *bits, size_t count, size_t stride);
+  ~Device();
+
+private:
+  Device(const Device &);
+  Device &operator=(const Device &);
+};
+
+#endif
@@ -21,37 +21,583 @@
 // Or just run 'make bitvectors-parents.data' for the "solution".
 
 #include <algorithm>
-#include <bitset>
+#include <atomic>
+#include <cmath>
 #include <cassert>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
 #include <fstream>
 #include <iostream>
-#include <list>
-#include <map>
-#include <set>
+#include <mutex>
+#include <queue>
 #include <sstream>
+#include <streambuf>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#if defined(__x86_64__)
+#define BVG_X86
+#include <immintrin.h>
+#endif
+
+#ifdef BVG_GPU
+#include "bvg-gpu.h"
+#endif
+
+#ifdef BVG_MPI
+#include <mpi.h>
+#endif
+
 using namespace std;
 
 
 static void showUsage(ostream &errs, const char *cmd)
 {
   errs << endl
-       << "Usage: " << cmd << " <prob> <data>" << endl
+       << "Usage: " << cmd << " [<option> ...] <prob> <data>" << endl
        << "Where: <prop> is the bitwise probability of mutation " << endl
        << "              as an integer percentage (20 for example). " << endl
-       << "       <data> is a file of " << SCALE
-       << " bit strings of length " << SCALE << "." << endl
-       << "Each line matches the regular expression "
-       << "'^[01]{" << SCALE << "}$', " << endl
-       << "and there are " << SCALE << " lines in <data>." << endl
+       << "       <data> is a file of bit strings, one per line." << endl
+       << "Each line matches the regular expression '^[01]+$', " << endl
+       << "and every line in <data> is as long as the first." << endl
+       << endl
+       << "A packed population file, as written by --convert, "
+       << "may stand in for <data>." << endl
+       << endl
+       << "Options: --convert <file>  Write <data> to <file> as a "
+       << "packed population" << endl
+       << "                           and stop." << endl
+       << "         --generate <n>    Write <n> bitvectors grown as a "
+       << "random tree to" << endl
+       << "                           <data> instead of reading it, "
+       << "and stop." << endl
+       << "         --bits <n>        Grow bitvectors of <n> bits "
+       << "(10000)." << endl
+       << "         --packed          Grow them into a packed population "
+       << "file." << endl
+       << "         --parents <file>  Write the index of each one's "
+       << "parent to <file>." << endl
+       << "         --seed <n>        Grow them from seed <n> (1)." << endl
+       << "         --engine kruskal  Sort all relations to find the "
+       << "spanning graph (default)." << endl
+       << "         --engine prim     Grow the spanning graph without "
+       << "storing relations." << endl
+       << "         --engine lazy     Join relations from raw distances "
+       << "a few at a time." << endl
+       << "         --engine approx   Join only relations that hashing "
+       << "finds close." << endl
+       << "         --engine boruvka  Join subgraphs to their closest "
+       << "in parallel rounds." << endl
+       << "         --checkpoint <file>" << endl
+       << "                           Save the distances and join of "
+       << "lazy to <file>" << endl
+       << "                           and <file>.join as it goes."
+       << endl
+       << "         --checkpoint-interval <n>" << endl
+       << "                           Save the join at most every <n> "
+       << "seconds (300)." << endl
+       << "         --resume          Carry on from the checkpoint "
+       << "instead of starting" << endl
+       << "                           over." << endl
+       << "         --hash-tables <n> Hash into <n> tables for approx "
+       << "(128)." << endl
+       << "         --hash-bits <n>   Hash <n> random bits for approx "
+       << "(12)." << endl
+       << "         --incremental <tree>" << endl
+       << "                           Extend the spanning graph in "
+       << "<tree> to the" << endl
+       << "                           bitvectors appended to <data> "
+       << "since." << endl
+       << "         --kernel <name>   Count bit differences with the "
+       << "scalar, avx2, or" << endl
+       << "                           avx512 kernel instead of the "
+       << "fastest (auto)." << endl
+       << "         --memory-budget <n>" << endl
+       << "                           Keep at most <n> MiB of relations "
+       << "for kruskal," << endl
+       << "                           spilling sorted runs to TMPDIR "
+       << "beyond that." << endl
+       << "         --numa pin        Pin threads to the NUMA nodes in "
+       << "turn (off)." << endl
+       << "         --numa replicate  Pin them and copy the bitvectors "
+       << "to each node." << endl
+       << "         --query <k>       Answer each line of stdin, a "
+       << "bitvector or the" << endl
+       << "                           index of one in <data>, with "
+       << "the <k> nearest." << endl
+       << "         --sort std        Sort relations with std::sort() "
+       << "instead of by" << endl
+       << "                           counting each distance (counting)."
+       << endl
+       << "         --relations compact" << endl
+       << "                           Store relations in 8 bytes "
+       << "instead of 16 (wide)." << endl
+       << "         --save-tree <tree>" << endl
+       << "                           Write the spanning graph to "
+       << "<tree>." << endl
+       << "         --tiling naive    Count bits different a pair at a "
+       << "time instead of" << endl
+       << "                           in blocks of 4 by 4 (blocked)."
+       << endl
+       << "         --sweep <file>    Take <prob> as a list such as "
+       << "5,10,20, and write" << endl
+       << "                           a genealogy for each to <file> "
+       << "with '%' replaced" << endl
+       << "                           by it, finding distances once with "
+       << "lazy." << endl
+       << "         --stats <file>    Write the time and memory of each "
+       << "phase, and" << endl
+       << "                           counts of the work done, to <file> "
+       << "as JSON," << endl
+       << "                           or to stderr if <file> is '-'."
+       << endl
+       << "         --threads <n>     Compute distances on <n> threads "
+       << "(the default" << endl
+       << "                           is one per processor)." << endl
+       << "         --validate        Report how the spanning graph "
+       << "differs from the" << endl
+       << "                           one kruskal finds." << endl
        << endl;
 }
 
 
-// A vector of SCALE bits with mutationPercentage, the bitwise
-// probability of mutation each generation.
+// The NUMA nodes of this machine, each the processors on it that this
+// process may run on, as sysfs lists them, and how Workers place
+// their threads on them: anywhere (OFF), pinning each thread to the
+// processors of one node, in turn (PIN), or pinning them and also
+// giving each node a Replica of the population (REPLICATE).  The
+// node of the calling thread is node, or -1 if it is not pinned, and
+// the tasks each node has run, and the nanoseconds its threads spent
+// running them, are in tasks and busy.
+//
+struct Numa
+{
+  enum Placement { OFF, PIN, REPLICATE };
+  static Placement placement;
+  static vector<vector<int> > nodes;
+  static thread_local int node;
+  static vector<atomic<uint64_t> > tasks;
+  static vector<atomic<uint64_t> > busy;
+
+  // Return the processors listed in s, such as "0-3,8-11".
+  //
+  static vector<int> parse(const string &s) {
+    vector<int> result;
+    istringstream iss(s);
+    string range;
+    while (getline(iss, range, ',')) {
+      int first = -1, last = -1;
+      char dash = 0;
+      istringstream r(range);
+      if (!(r >> first)) continue;
+      last = r >> dash >> last && dash == '-' ? last : first;
+      for (int cpu = first; cpu <= last; ++cpu) result.push_back(cpu);
+    }
+    return result;
+  }
+
+  // True if threads can be pinned to nodes on this platform, which
+  // needs the sched affinity calls of Linux.
+  //
+  static bool supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+  }
+
+#ifdef __linux__
+
+  // Find the nodes from sysfs, keeping only the processors this
+  // process may run on, or make one node of all of those if sysfs
+  // says nothing.
+  //
+  static void discover() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof allowed, &allowed);
+    nodes.clear();
+    const string root("/sys/devices/system/node/");
+    ifstream online((root + "online").c_str());
+    string list;
+    getline(online, list);
+    const vector<int> ids(parse(list));
+    for (size_t k = 0; k < ids.size(); ++k) {
+      ostringstream path;
+      path << root << "node" << ids[k] << "/cpulist";
+      ifstream s(path.str().c_str());
+      string cpus;
+      getline(s, cpus);
+      vector<int> usable;
+      const vector<int> all(parse(cpus));
+      for (size_t c = 0; c < all.size(); ++c) {
+        if (all[c] < CPU_SETSIZE && CPU_ISSET(all[c], &allowed)) {
+          usable.push_back(all[c]);
+        }
+      }
+      if (!usable.empty()) nodes.push_back(usable);
+    }
+    if (nodes.empty()) {
+      nodes.push_back(vector<int>());
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) nodes.back().push_back(cpu);
+      }
+    }
+    vector<atomic<uint64_t> >(nodes.size()).swap(tasks);
+    vector<atomic<uint64_t> >(nodes.size()).swap(busy);
+  }
+
+  // Run the calling thread on the processors of node n from
+  // construction to destruction, unless n is -1.
+  //
+  struct Pin
+  {
+    int previous;
+    cpu_set_t saved;
+    bool pinned;
+
+    Pin(int n): previous(node), pinned(false) {
+      if (n < 0) return;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (size_t c = 0; c < nodes[n].size(); ++c) CPU_SET(nodes[n][c], &set);
+      pinned = pthread_getaffinity_np(pthread_self(), sizeof saved, &saved) == 0
+        && pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+      if (pinned) node = n;
+    }
+
+    ~Pin() {
+      if (pinned) pthread_setaffinity_np(pthread_self(), sizeof saved, &saved);
+      node = previous;
+    }
+  };
+
+#else
+
+  // Make one node, with no processors listed, and never pin to it.
+  //
+  static void discover() {
+    nodes.assign(1, vector<int>());
+    vector<atomic<uint64_t> >(nodes.size()).swap(tasks);
+    vector<atomic<uint64_t> >(nodes.size()).swap(busy);
+  }
+
+  struct Pin
+  {
+    Pin(int) {}
+  };
+
+#endif
+
+  // Return the node Workers thread k runs on, or -1 if none.
+  //
+  static int of(size_t k) {
+    return placement == OFF || nodes.empty() ? -1 : int(k % nodes.size());
+  }
+
+  // Note that node n ran count tasks in seconds.
+  //
+  static void note(int n, size_t count, double seconds) {
+    tasks[n] += count;
+    busy[n] += uint64_t(seconds * 1e9);
+  }
+};
+
+
+// Where a run spends its time and memory: the wall and CPU seconds of
+// each named phase, summed over each time it runs, the resident
+// memory at the start and end of the last time it ran, and the most
+// resident memory while it ran, with named counters of the work
+// done.  Phases may nest, in which case the inner phase is counted in
+// the outer as well.  Only the main thread records anything.
+//
+// On Linux, each phase resets the high-water mark of the process when
+// it starts, by writing 5 to /proc/self/clear_refs, and reads VmHWM
+// from /proc/self/status when it ends, first noting the mark so far
+// in every phase still open.  Elsewhere, or if that cannot be reset,
+// the peak of a phase is only the peak of the process when it ends.
+//
+struct Stats
+{
+  struct Entry
+  {
+    string name;
+    size_t calls;
+    double wall, cpu;
+    long start, finish, peak;
+  };
+
+  struct Phase;
+
+  static vector<Entry> phases;
+  static vector<pair<string, uint64_t> > counters;
+  static vector<Phase *> open;
+  static bool resets;
+  static long summit;
+
+  static double wall() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+  }
+
+  // Return the CPU seconds of all threads so far.
+  //
+  static double cpu() {
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return u.ru_utime.tv_sec + u.ru_stime.tv_sec
+      + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) * 1e-6;
+  }
+
+  // Return the peak resident set in KiB of the process so far, which
+  // is at least summit, the highest mark before any reset().
+  //
+  static long peak() {
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return max(summit, long(u.ru_maxrss));
+  }
+
+  // Return the resident set in KiB now, or 0 if /proc does not say.
+  //
+  static long resident() {
+    ifstream statm("/proc/self/statm");
+    long pages = 0, rss = 0;
+    if (!(statm >> pages >> rss)) return 0;
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+
+  // Return the peak resident set in KiB since the last reset(), or
+  // since the process started.
+  //
+  static long highWater() {
+    if (!resets) return peak();
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+      if (line.compare(0, 6, "VmHWM:") == 0) return atol(line.c_str() + 6);
+    }
+    return peak();
+  }
+
+  // Add n to the counter named name.
+  //
+  static void count(const char *name, uint64_t n) {
+    for (size_t k = 0; k < counters.size(); ++k) {
+      if (counters[k].first == name) {
+        counters[k].second += n;
+        return;
+      }
+    }
+    counters.push_back(make_pair(string(name), n));
+  }
+
+  // Time the phase named name from construction until end(), or
+  // until destruction if end() is never called.
+  //
+  struct Phase
+  {
+    const char *name;
+    double wall, cpu;
+    long start, peak;
+
+    void end() {
+      if (!name) return;
+      open.erase(find(open.begin(), open.end(), this));
+      Entry *e = 0;
+      for (size_t k = 0; !e && k < phases.size(); ++k) {
+        if (phases[k].name == name) e = &phases[k];
+      }
+      if (!e) {
+        const Entry fresh = { name, 0, 0, 0, 0, 0, 0 };
+        phases.push_back(fresh);
+        e = &phases.back();
+      }
+      ++e->calls;
+      e->wall += Stats::wall() - wall;
+      e->cpu += Stats::cpu() - cpu;
+      e->start = start;
+      e->finish = resident();
+      e->peak = max(e->peak, max(peak, highWater()));
+      name = 0;
+    }
+
+    Phase(const char *n):
+      name(n), wall(Stats::wall()), cpu(Stats::cpu()), start(resident()),
+      peak(0)
+    {
+      reset();
+      open.push_back(this);
+    }
+
+    ~Phase() { end(); }
+  };
+
+  // Reset the high-water mark to the resident set now, if possible,
+  // noting it first in every phase open, and in summit.  Return false
+  // if it cannot be reset.
+  //
+  static bool reset() {
+#ifdef __linux__
+    const long mark = highWater();
+    summit = max(summit, mark);
+    for (size_t k = 0; k < open.size(); ++k) {
+      open[k]->peak = max(open[k]->peak, mark);
+    }
+    ofstream clear("/proc/self/clear_refs");
+    resets = bool(clear << 5 << flush);
+#endif
+    return resets;
+  }
+
+  // Write the phases, in the order each first ended, counters, and
+  // unless Numa::placement is OFF, the work of each node, to s as a
+  // JSON object.
+  //
+  static void write(ostream &s) {
+    ostringstream oss;
+    oss.setf(ios::fixed); oss.precision(6);
+    oss << "{\n  \"phases\": [";
+    for (size_t k = 0; k < phases.size(); ++k) {
+      const Entry &e = phases[k];
+      oss << (k ? "," : "") << "\n    {\"name\": \"" << e.name
+          << "\", \"calls\": " << e.calls
+          << ", \"wall_seconds\": " << e.wall
+          << ", \"cpu_seconds\": " << e.cpu
+          << ", \"start_rss_kib\": " << e.start
+          << ", \"end_rss_kib\": " << e.finish
+          << (resets ? ", \"peak_rss_kib\": "
+              : ", \"process_peak_rss_kib_so_far\": ") << e.peak << "}";
+    }
+    oss << "\n  ],\n  \"counters\": {";
+    for (size_t k = 0; k < counters.size(); ++k) {
+      oss << (k ? "," : "") << "\n    \"" << counters[k].first << "\": "
+          << counters[k].second;
+    }
+    oss << "\n  },";
+    if (Numa::placement != Numa::OFF) {
+      oss << "\n  \"nodes\": [";
+      for (size_t n = 0; n < Numa::nodes.size(); ++n) {
+        const double busy = Numa::busy[n] * 1e-9;
+        const uint64_t tasks = Numa::tasks[n];
+        oss << (n ? "," : "") << "\n    {\"node\": " << n
+            << ", \"processors\": " << Numa::nodes[n].size()
+            << ", \"tasks\": " << tasks
+            << ", \"busy_seconds\": " << busy
+            << ", \"tasks_per_second\": " << (busy > 0 ? tasks / busy : 0)
+            << "}";
+      }
+      oss << "\n  ],";
+    }
+    oss << "\n  \"peak_rss_kib\": " << max(peak(), highWater()) << "\n}\n";
+    s << oss.str() << flush;
+  }
+
+  // Write the Stats to the file at path, or to cerr if path is "-",
+  // when this is destroyed, unless path is 0.
+  //
+  struct Report
+  {
+    const char *path;
+
+    ~Report() {
+      if (!path) return;
+      if (string(path) == "-") {
+        write(cerr);
+      } else {
+        ofstream s(path);
+        write(s);
+      }
+    }
+
+    Report(const char *p): path(p) {}
+  };
+};
+
+
+// Run tasks numbered 0 to count - 1 on threads threads, including
+// the calling thread, where each thread takes the lowest numbered
+// task not yet started until none are left.  Return when all tasks
+// are finished, or at once if there are none, and never start more
+// threads than tasks.  Thread k runs on Numa node Numa::of(k), if any.
+//
+struct Workers
+{
+  static size_t threads;
+
+  template <typename Task>
+  struct Runner
+  {
+    Task &task;
+    size_t count;
+    atomic<size_t> next;
+
+    void operator()(int node) {
+      const Numa::Pin pin(node);
+      const double start = node < 0 ? 0 : Stats::wall();
+      size_t done = 0;
+      for (size_t n = next++; n < count; n = next++, ++done) task(n);
+      if (node >= 0) Numa::note(node, done, Stats::wall() - start);
+    }
+
+    Runner(Task &t, size_t c): task(t), count(c), next(0) {}
+  };
+
+  template <typename Task>
+  static void run(size_t count, Task &task)
+  {
+    if (count == 0) return;
+    Runner<Task> runner(task, count);
+    vector<thread> helpers;
+    const size_t extra = max<size_t>(min(threads, count), 1) - 1;
+    for (size_t n = 0; n < extra; ++n) {
+      helpers.push_back(thread(ref(runner), Numa::of(n + 1)));
+    }
+    runner(Numa::of(0));
+    for (size_t n = 0; n < helpers.size(); ++n) helpers[n].join();
+  }
+};
+
+
+// A seedable pseudo-random number generator (SplitMix64), so that
+// anything drawn from a seed is the same on every run and platform.
+//
+struct Random
+{
+  uint64_t state;
+
+  uint64_t operator()() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  Random(uint64_t seed): state(seed) {}
+};
+
+
+// A vector of size bits with mutationPercentage, the bitwise
+// probability of mutation each generation.  The bits are packed into
+// stride 64-bit words owned by some Population, with any bits past
+// size in the last word clear.
 //
 // The difference of two BitVectors is the number of bits different
 // between lhs and rhs normalized to the expected mutation count.
@@ -59,310 +605,3516 @@ static void showUsage(ostream &errs, const char *cmd)
 struct BitVector
 {
   static int mutationPercentage;
+  static size_t size;
+  static size_t stride;
+  static size_t expected;
+  static size_t (*count)(const uint64_t *lhs, const uint64_t *rhs);
   int index;
-  bitset<SCALE> bits;
+  const uint64_t *bits;
+  size_t ones;
+
+  // The ways to count the bits different between two BitVectors.
+  // AUTO picks the fastest one this processor supports.
+  //
+  enum Kernel { AUTO, SCALAR, AVX2, AVX512 };
+  static Kernel kernel;
+
+  // Return the number of bits different between the Words words at
+  // lhs and rhs, or between stride words if Words is 0.  A fixed
+  // count of words lets the compiler unroll the loop for the widths
+  // listed in initialize().
+  //
+  template <size_t Words>
+  static size_t countScalar(const uint64_t *lhs, const uint64_t *rhs)
+  {
+    const size_t words = Words ? Words : stride;
+    size_t result = 0;
+    for (size_t n = 0; n < words; ++n) {
+      result += __builtin_popcountll(lhs[n] ^ rhs[n]);
+    }
+    return result;
+  }
+
+#ifdef BVG_X86
+
+  // Return the count of bits set in each 64-bit lane of v by looking
+  // up the count for each nibble.
+  //
+  __attribute__((target("avx2")))
+  static __m256i popcount256(__m256i v)
+  {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                            1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3,
+                                            1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i lo = _mm256_and_si256(v, nibble);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                          _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+  }
+
+  // Carry-save add a, b, and c into the sum bits l and carry bits h.
+  //
+  __attribute__((target("avx2")))
+  static void csa(__m256i &h, __m256i &l, __m256i a, __m256i b, __m256i c)
+  {
+    const __m256i u = _mm256_xor_si256(a, b);
+    h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    l = _mm256_xor_si256(u, c);
+  }
+
+  // Return the XOR of the 4 words at lhs + n and rhs + n.
+  //
+  __attribute__((target("avx2")))
+  static __m256i xor256(const uint64_t *lhs, const uint64_t *rhs, size_t n)
+  {
+    return _mm256_xor_si256(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + n)),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + n)));
+  }
+
+  // Like countScalar() but with a Harley-Seal carry-save adder tree
+  // over blocks of 16 AVX2 vectors, so only one in 16 vectors needs
+  // a full popcount.  Fewer than 64 words left over are counted a
+  // vector and then a word at a time.
+  //
+  template <size_t Words>
+  __attribute__((target("avx2,popcnt")))
+  static size_t countAvx2(const uint64_t *lhs, const uint64_t *rhs)
+  {
+    const size_t words = Words ? Words : stride;
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = total, twos = total, fours = total, eights = total;
+    __m256i sixteens, twosA, twosB, foursA, foursB, eightsA, eightsB;
+    size_t n = 0;
+    for (; n + 64 <= words; n += 64) {
+      csa(twosA, ones, ones, xor256(lhs, rhs, n), xor256(lhs, rhs, n + 4));
+      csa(twosB, ones, ones, xor256(lhs, rhs, n + 8), xor256(lhs, rhs, n + 12));
+      csa(foursA, twos, twos, twosA, twosB);
+      csa(twosA, ones, ones, xor256(lhs, rhs, n + 16), xor256(lhs, rhs, n + 20));
+      csa(twosB, ones, ones, xor256(lhs, rhs, n + 24), xor256(lhs, rhs, n + 28));
+      csa(foursB, twos, twos, twosA, twosB);
+      csa(eightsA, fours, fours, foursA, foursB);
+      csa(twosA, ones, ones, xor256(lhs, rhs, n + 32), xor256(lhs, rhs, n + 36));
+      csa(twosB, ones, ones, xor256(lhs, rhs, n + 40), xor256(lhs, rhs, n + 44));
+      csa(foursA, twos, twos, twosA, twosB);
+      csa(twosA, ones, ones, xor256(lhs, rhs, n + 48), xor256(lhs, rhs, n + 52));
+      csa(twosB, ones, ones, xor256(lhs, rhs, n + 56), xor256(lhs, rhs, n + 60));
+      csa(foursB, twos, twos, twosA, twosB);
+      csa(eightsB, fours, fours, foursA, foursB);
+      csa(sixteens, eights, eights, eightsA, eightsB);
+      total = _mm256_add_epi64(total, popcount256(sixteens));
+    }
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(twos), 1));
+    total = _mm256_add_epi64(total, popcount256(ones));
+    const size_t vectors = words - words % 4;
+    for (; n < vectors; n += 4) {
+      total = _mm256_add_epi64(total, popcount256(xor256(lhs, rhs, n)));
+    }
+    size_t result = _mm256_extract_epi64(total, 0)
+      + _mm256_extract_epi64(total, 1)
+      + _mm256_extract_epi64(total, 2)
+      + _mm256_extract_epi64(total, 3);
+    for (n = vectors; n < words; ++n) {
+      result += _mm_popcnt_u64(lhs[n] ^ rhs[n]);
+    }
+    return result;
+  }
+
+  // Like countScalar() but 8 words at a time with VPOPCNTQ.  The
+  // last fewer than 8 words are read with a masked load.
+  //
+  template <size_t Words>
+  __attribute__((target("avx512f,avx512vpopcntdq")))
+  static size_t countAvx512(const uint64_t *lhs, const uint64_t *rhs)
+  {
+    const size_t words = Words ? Words : stride;
+    __m512i total = _mm512_setzero_si512();
+    size_t n = 0;
+    for (; n + 8 <= words; n += 8) {
+      const __m512i l = _mm512_loadu_si512(lhs + n);
+      const __m512i r = _mm512_loadu_si512(rhs + n);
+      total = _mm512_add_epi64(total,
+                               _mm512_popcnt_epi64(_mm512_xor_si512(l, r)));
+    }
+    if (n < words) {
+      const __mmask8 mask = (1u << (words - n)) - 1;
+      const __m512i l = _mm512_maskz_loadu_epi64(mask, lhs + n);
+      const __m512i r = _mm512_maskz_loadu_epi64(mask, rhs + n);
+      total = _mm512_add_epi64(total,
+                               _mm512_popcnt_epi64(_mm512_xor_si512(l, r)));
+    }
+    return _mm512_reduce_add_epi64(total);
+  }
+
+#endif
+
+  // The side of the square blocks of counts that countBlock() finds
+  // at once, and whether tiles of bitvectors are counted a block
+  // (BLOCKED) or a pair at a time (NAIVE).
+  //
+  static const size_t BLOCK = 4;
+  enum Tiling { BLOCKED, NAIVE };
+  static Tiling tiling;
+
+  // Set counts[a * BLOCK + b] to the number of bits different between
+  // the Words words at lhs[a] and rhs[b], or stride words if Words is
+  // 0, for every a and b less than BLOCK.  Each word of the BLOCK left
+  // and right bitvectors is loaded once for BLOCK counts, which stay
+  // in registers until the end.
+  //
+  template <size_t Words>
+  static void blockScalar(const uint64_t *const *lhs,
+                          const uint64_t *const *rhs, size_t *counts)
+  {
+    const size_t words = Words ? Words : stride;
+    size_t total[BLOCK * BLOCK] = {};
+    for (size_t n = 0; n < words; ++n) {
+      uint64_t r[BLOCK];
+      for (size_t b = 0; b < BLOCK; ++b) r[b] = rhs[b][n];
+      for (size_t a = 0; a < BLOCK; ++a) {
+        const uint64_t l = lhs[a][n];
+        for (size_t b = 0; b < BLOCK; ++b) {
+          total[a * BLOCK + b] += __builtin_popcountll(l ^ r[b]);
+        }
+      }
+    }
+    for (size_t n = 0; n < BLOCK * BLOCK; ++n) counts[n] = total[n];
+  }
+
+#ifdef BVG_X86
+
+  // Like blockScalar() but 4 words at a time with AVX2, summing the
+  // counts of each nibble in bytes, which cannot overflow in fewer
+  // than 32 vectors, before adding them up in 64-bit lanes.
+  //
+  template <size_t Words>
+  __attribute__((target("avx2,popcnt")))
+  static void blockAvx2(const uint64_t *const *lhs,
+                        const uint64_t *const *rhs, size_t *counts)
+  {
+    const size_t words = Words ? Words : stride;
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                            1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3,
+                                            1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i total[BLOCK * BLOCK];
+    for (size_t n = 0; n < BLOCK * BLOCK; ++n) {
+      total[n] = _mm256_setzero_si256();
+    }
+    const size_t vectors = words - words % 4;
+    for (size_t n = 0; n < vectors;) {
+      const size_t end = min(vectors, n + 4 * 31);
+      __m256i bytes[BLOCK * BLOCK];
+      for (size_t k = 0; k < BLOCK * BLOCK; ++k) {
+        bytes[k] = _mm256_setzero_si256();
+      }
+      for (; n < end; n += 4) {
+        __m256i l[BLOCK];
+        for (size_t a = 0; a < BLOCK; ++a) {
+          l[a] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs[a] + n));
+        }
+        for (size_t b = 0; b < BLOCK; ++b) {
+          const __m256i r = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(rhs[b] + n));
+          for (size_t a = 0; a < BLOCK; ++a) {
+            const __m256i x = _mm256_xor_si256(l[a], r);
+            const __m256i lo = _mm256_and_si256(x, nibble);
+            const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+            bytes[a * BLOCK + b] = _mm256_add_epi8(
+              bytes[a * BLOCK + b],
+              _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                              _mm256_shuffle_epi8(lookup, hi)));
+          }
+        }
+      }
+      for (size_t k = 0; k < BLOCK * BLOCK; ++k) {
+        total[k] = _mm256_add_epi64(
+          total[k], _mm256_sad_epu8(bytes[k], _mm256_setzero_si256()));
+      }
+    }
+    for (size_t a = 0; a < BLOCK; ++a) {
+      for (size_t b = 0; b < BLOCK; ++b) {
+        const __m256i t = total[a * BLOCK + b];
+        size_t result = _mm256_extract_epi64(t, 0) + _mm256_extract_epi64(t, 1)
+          + _mm256_extract_epi64(t, 2) + _mm256_extract_epi64(t, 3);
+        for (size_t n = vectors; n < words; ++n) {
+          result += _mm_popcnt_u64(lhs[a][n] ^ rhs[b][n]);
+        }
+        counts[a * BLOCK + b] = result;
+      }
+    }
+  }
+
+  // Like blockScalar() but 8 words at a time with VPOPCNTQ, keeping
+  // the BLOCK * BLOCK sums, and the BLOCK left vectors, in registers.
+  //
+  template <size_t Words>
+  __attribute__((target("avx512f,avx512vpopcntdq")))
+  static void blockAvx512(const uint64_t *const *lhs,
+                          const uint64_t *const *rhs, size_t *counts)
+  {
+    const size_t words = Words ? Words : stride;
+    __m512i total[BLOCK * BLOCK];
+    for (size_t n = 0; n < BLOCK * BLOCK; ++n) {
+      total[n] = _mm512_setzero_si512();
+    }
+    for (size_t n = 0; n < words; n += 8) {
+      const __mmask8 mask = words - n >= 8 ? 0xff : (1u << (words - n)) - 1;
+      __m512i l[BLOCK];
+      for (size_t a = 0; a < BLOCK; ++a) {
+        l[a] = _mm512_maskz_loadu_epi64(mask, lhs[a] + n);
+      }
+      for (size_t b = 0; b < BLOCK; ++b) {
+        const __m512i r = _mm512_maskz_loadu_epi64(mask, rhs[b] + n);
+        for (size_t a = 0; a < BLOCK; ++a) {
+          const __m512i x = _mm512_xor_si512(l[a], r);
+          total[a * BLOCK + b] = _mm512_add_epi64(total[a * BLOCK + b],
+                                                  _mm512_popcnt_epi64(x));
+        }
+      }
+    }
+    for (size_t n = 0; n < BLOCK * BLOCK; ++n) {
+      counts[n] = _mm512_reduce_add_epi64(total[n]);
+    }
+  }
+
+#endif
+
+  // Count a block of bits different at a time with the way
+  // initialize() chose for kernel.
+  //
+  static void (*countBlock)(const uint64_t *const *lhs,
+                            const uint64_t *const *rhs, size_t *counts);
+
+  // True if this processor can run kernel k.
+  //
+  static bool supports(Kernel k)
+  {
+    switch (k) {
+    case AUTO: case SCALAR: return true;
+#ifdef BVG_X86
+    case AVX2: return __builtin_cpu_supports("avx2")
+        && __builtin_cpu_supports("popcnt");
+    case AVX512: return __builtin_cpu_supports("avx512f")
+        && __builtin_cpu_supports("avx512vpopcntdq");
+#else
+    case AVX2: case AVX512: return false;
+#endif
+    }
+    return false;
+  }
+
+  // Return the count function of kernel for Words words, choosing
+  // the fastest supported kernel when that is AUTO.
+  //
+  template <size_t Words>
+  static size_t (*choose())(const uint64_t *, const uint64_t *)
+  {
+#ifdef BVG_X86
+    if (kernel == AVX512 || (kernel == AUTO && supports(AVX512))) {
+      return &countAvx512<Words>;
+    }
+    if (kernel == AVX2 || (kernel == AUTO && supports(AVX2))) {
+      return &countAvx2<Words>;
+    }
+#endif
+    return &countScalar<Words>;
+  }
+
+  // Return the countBlock function of kernel for Words words, the
+  // same way choose() does.
+  //
+  template <size_t Words>
+  static void (*chooseBlock())(const uint64_t *const *,
+                               const uint64_t *const *, size_t *)
+  {
+#ifdef BVG_X86
+    if (kernel == AVX512 || (kernel == AUTO && supports(AVX512))) {
+      return &blockAvx512<Words>;
+    }
+    if (kernel == AVX2 || (kernel == AUTO && supports(AVX2))) {
+      return &blockAvx2<Words>;
+    }
+#endif
+    return &blockScalar<Words>;
+  }
+
+  // The words within() counts between checks of its bound, the count
+  // function for CHUNK words, and the count function for the fewer
+  // than CHUNK words left over at the end of each BitVector, or 0 if
+  // none are.
+  //
+  static const size_t CHUNK = 32;
+  static size_t (*countChunk)(const uint64_t *lhs, const uint64_t *rhs);
+  static size_t (*countTail)(const uint64_t *lhs, const uint64_t *rhs);
+
+  // Return the count function of kernel for words words, where words
+  // is at most Words, or 0 if words is 0.
+  //
+  template <size_t Words>
+  static size_t (*chooseTail(size_t words))(const uint64_t *,
+                                            const uint64_t *)
+  {
+    if (words == 0) return 0;
+    if (words == Words) return choose<Words>();
+    return chooseTail<(Words > 1 ? Words - 1 : 1)>(words);
+  }
+
+  // Normalize distances to percentage from now on.
+  //
+  static void reset(int percentage)
+  {
+    mutationPercentage = percentage;
+    expected = size * mutationPercentage / 100;
+  }
+
+  // Set up for BitVectors of bitCount bits, with mutationPercentage
+  // already set.
+  //
+  static void initialize(size_t bitCount)
+  {
+    size = bitCount;
+    stride = (bitCount + 63) / 64;
+    expected = size * mutationPercentage / 100;
+    switch (stride) {
+    case   2: count = choose<2>();   countBlock = chooseBlock<2>();   break;
+    case   4: count = choose<4>();   countBlock = chooseBlock<4>();   break;
+    case   8: count = choose<8>();   countBlock = chooseBlock<8>();   break;
+    case  16: count = choose<16>();  countBlock = chooseBlock<16>();  break;
+    case 157: count = choose<157>(); countBlock = chooseBlock<157>(); break;
+    default:  count = choose<0>();   countBlock = chooseBlock<0>();   break;
+    }
+    countChunk = choose<CHUNK>();
+    countTail = chooseTail<CHUNK - 1>(stride % CHUNK);
+    pack = &packScalar;
+#ifdef BVG_X86
+    if (kernel != SCALAR && supports(AVX2)) pack = &packAvx2;
+#endif
+  }
+
+  // Pack the characters of '0' and '1' from n up to size at s into
+  // the zeroed stride words at w, such that character n is bit n % 64
+  // of word n / 64.  Return false if s has any other character.
+  //
+  static bool packScalar(uint64_t *w, const char *s, size_t n)
+  {
+    for (; n < size; ++n) {
+      const char c = s[n];
+      if (c == '1') {
+        w[n / 64] |= uint64_t(1) << (n % 64);
+      } else if (c != '0') {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool packScalar(uint64_t *w, const char *s)
+  {
+    return packScalar(w, s, 0);
+  }
+
+#ifdef BVG_X86
+
+  // Like packScalar() but compare 64 characters at a time to '0' and
+  // '1' with AVX2, and pack the comparisons straight into a word.
+  //
+  __attribute__((target("avx2")))
+  static bool packAvx2(uint64_t *w, const char *s)
+  {
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i one = _mm256_set1_epi8('1');
+    size_t n = 0;
+    for (; n + 64 <= size; n += 64) {
+      const __m256i lo = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + n));
+      const __m256i hi = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + n + 32));
+      const __m256i loOnes = _mm256_cmpeq_epi8(lo, one);
+      const __m256i hiOnes = _mm256_cmpeq_epi8(hi, one);
+      const uint32_t loValid = _mm256_movemask_epi8(
+        _mm256_or_si256(loOnes, _mm256_cmpeq_epi8(lo, zero)));
+      const uint32_t hiValid = _mm256_movemask_epi8(
+        _mm256_or_si256(hiOnes, _mm256_cmpeq_epi8(hi, zero)));
+      if ((loValid & hiValid) != 0xffffffff) return false;
+      w[n / 64] = uint64_t(uint32_t(_mm256_movemask_epi8(loOnes)))
+        | uint64_t(uint32_t(_mm256_movemask_epi8(hiOnes))) << 32;
+    }
+    return packScalar(w, s, n);
+  }
+
+#endif
+
+  // Pack the size characters at s into the zeroed stride words at w
+  // with the fastest way initialize() found.  Return false if s has
+  // a character other than '0' or '1'.
+  //
+  static bool (*pack)(uint64_t *w, const char *s);
+
+  // Return the number of bits different between BitVectors, distance,
+  // normalized to the expected mutation count e, without a branch.
+  //
+  static size_t normalize(size_t distance, size_t e)
+  {
+    const ptrdiff_t d = ptrdiff_t(distance) - ptrdiff_t(e);
+    const ptrdiff_t sign = d >> (8 * sizeof d - 1);
+    return (d ^ sign) - sign;
+  }
+
+  // Return distance normalized to the expected mutation count, which
+  // initialize() finds.
+  //
+  static size_t normalize(size_t distance)
+  {
+    return normalize(distance, expected);
+  }
+
+  friend size_t operator-(const BitVector &lhs, const BitVector &rhs)
+  {
+    return normalize(count(lhs.bits, rhs.bits));
+  }
+
+  // Return the least lhs - rhs could be given only their counts of
+  // ones: the bits different between them are at least the
+  // difference of those counts and at most their sum, or the sum of
+  // their zeros if that is less.
+  //
+  static size_t least(const BitVector &lhs, const BitVector &rhs)
+  {
+    const size_t low = max(lhs.ones, rhs.ones) - min(lhs.ones, rhs.ones);
+    const size_t high = min(lhs.ones + rhs.ones,
+                            2 * size - lhs.ones - rhs.ones);
+    if (expected < low) return low - expected;
+    if (expected > high) return expected - high;
+    return 0;
+  }
+
+  // Return lhs - rhs if it is at most bound, or else some nbd greater
+  // than bound, found with as little counting as possible.  Pairs
+  // whose counts of ones rule bound out are not counted at all, and
+  // otherwise the count stops at the first CHUNK of words after which
+  // the bits different so far are too many, or the bits left too few,
+  // to be within bound of the expected mutation count.
+  //
+  static size_t within(const BitVector &lhs, const BitVector &rhs,
+                       size_t bound)
+  {
+    if (bound >= size) return lhs - rhs;
+    if (least(lhs, rhs) > bound) return bound + 1;
+    const size_t high = expected + bound;
+    const size_t low = expected > bound ? expected - bound : 0;
+    size_t c = 0, k = 0;
+    for (; k + CHUNK <= stride; k += CHUNK) {
+      c += countChunk(lhs.bits + k, rhs.bits + k);
+      if (c > high || c + 64 * (stride - k - CHUNK) < low) return bound + 1;
+    }
+    if (countTail) c += countTail(lhs.bits + k, rhs.bits + k);
+    return normalize(c);
+  }
+
+  // Return the count of ones in the stride words at w.
+  //
+  static size_t countOnes(const uint64_t *w)
+  {
+    size_t result = 0;
+    for (size_t k = 0; k < stride; ++k) result += __builtin_popcountll(w[k]);
+    return result;
+  }
+
+  BitVector(): index(-1), bits(0), ones(0) {}
+  BitVector(int n, const uint64_t *w): index(n), bits(w), ones(countOnes(w)) {}
+};
+
+
+// The contents of the file at path mapped read-only into memory at
+// data.  *this is false if the file cannot be mapped, as when it is
+// empty or not a regular file.
+//
+struct MappedFile
+{
+  const char *data;
+  size_t size;
+
+  operator bool() const { return data != 0; }
+
+  // Unmap the file early.
+  //
+  void unmap() {
+    if (data) munmap(const_cast<char *>(data), size);
+    data = 0; size = 0;
+  }
+
+  // Tell the kernel how the mapping will be read, as madvise() does.
+  //
+  void advise(int advice) const {
+    if (data) madvise(const_cast<char *>(data), size, advice);
+  }
+
+  // Map the file at path, unless it is 0, or cannot be mapped.
+  //
+  void open(const char *path)
+  {
+    unmap();
+    if (!path) return;
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *const p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        data = static_cast<const char *>(p);
+        size = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const char *path): data(0), size(0) { open(path); }
+
+  ~MappedFile() { unmap(); }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+
+
+// The bytes of the gzip file at path as a stream buffer.  zlib
+// inflates the file on a thread of its own into a queue of at most
+// DEPTH chunks of CHUNK bytes, which the stream takes in turn, so
+// inflating the file overlaps parsing it.  The stream ends early if
+// the file is corrupt or truncated, and then failed is true.
+//
+struct Inflater: streambuf
+{
+  static const size_t CHUNK = 1 << 20;
+  static const size_t DEPTH = 4;
+  gzFile gz;
+  mutex lock;
+  condition_variable changed;
+  deque<string> chunks;
+  string chunk;
+  bool done, stop, failed;
+  thread inflating;
+
+  // True if the size bytes at data start as a gzip file does.
+  //
+  static bool marks(const char *data, size_t size) {
+    return size >= 2 && uint8_t(data[0]) == 0x1f && uint8_t(data[1]) == 0x8b;
+  }
+
+  // Inflate chunks into the queue until the file ends or stop.
+  //
+  void inflate() {
+    for (;;) {
+      string next(CHUNK, '\0');
+      const int n = gzread(gz, &next[0], CHUNK);
+      unique_lock<mutex> held(lock);
+      int err = Z_OK;
+      if (n == 0) gzerror(gz, &err);
+      if (n <= 0) { failed = n < 0 || err != Z_OK; break; }
+      next.resize(n);
+      while (chunks.size() >= DEPTH && !stop) changed.wait(held);
+      if (stop) break;
+      chunks.push_back(string());
+      chunks.back().swap(next);
+      changed.notify_all();
+    }
+    const lock_guard<mutex> held(lock);
+    done = true;
+    changed.notify_all();
+  }
+
+  // Take the next chunk from the queue, waiting for it if need be.
+  //
+  int underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    unique_lock<mutex> held(lock);
+    while (chunks.empty() && !done) changed.wait(held);
+    if (chunks.empty()) return traits_type::eof();
+    chunk.swap(chunks.front());
+    chunks.pop_front();
+    changed.notify_all();
+    char *const p = &chunk[0];
+    setg(p, p, p + chunk.size());
+    return traits_type::to_int_type(*p);
+  }
+
+  Inflater(const char *path):
+    gz(gzopen(path, "rb")), lock(), changed(), chunks(), chunk(),
+    done(!gz), stop(false), failed(!gz), inflating()
+  {
+    if (gz) inflating = thread(&Inflater::inflate, this);
+  }
+
+  ~Inflater() {
+    {
+      const lock_guard<mutex> held(lock);
+      stop = true;
+      changed.notify_all();
+    }
+    if (inflating.joinable()) inflating.join();
+    if (gz) gzclose(gz);
+  }
+};
+
+
+// The 64 bytes at the start of a packed population file, followed by
+// count rows of stride 64-bit words, each row the bits of a
+// BitVector of bits bits.  The words are in the byte order of the
+// machine that packed them, which order identifies, so a file packed
+// on a machine of the other byte order is refused.  The mutation
+// percentage the file was packed with is in percentage, or it is -1.
+//
+struct PackedHeader
+{
+  char magic[8];
+  uint64_t bits;
+  uint64_t count;
+  int64_t percentage;
+  uint64_t stride;
+  uint64_t order;
+  uint64_t reserved[2];
+
+  static const char *signature() { return "BVGPACK1"; }
+  static uint64_t byteOrder() { return 0x0102030405060708ULL; }
+
+  // True if the size bytes at data start with a signature.
+  //
+  static bool marks(const char *data, size_t size) {
+    return size >= sizeof(PackedHeader)
+      && memcmp(data, signature(), sizeof magic) == 0;
+  }
+
+  // True if the size bytes at data start with a signature but were
+  // packed in the other byte order.
+  //
+  static bool foreign(const char *data, size_t size) {
+    const PackedHeader *const h = reinterpret_cast<const PackedHeader *>(data);
+    return marks(data, size) && h->order == 0x0807060504030201ULL;
+  }
+
+  // True if the size bytes at data are a whole packed population of
+  // at most INT_MAX bitvectors of at most INT_MAX bits each.
+  //
+  static bool matches(const char *data, size_t size) {
+    const PackedHeader *const h = reinterpret_cast<const PackedHeader *>(data);
+    return marks(data, size) && h->order == byteOrder()
+      && h->bits > 0 && h->bits <= size_t(INT_MAX)
+      && h->stride == (h->bits + 63) / 64 && h->count <= size_t(INT_MAX)
+      && h->count <= (size - sizeof(PackedHeader)) / (h->stride * 8);
+  }
+
+  PackedHeader(size_t b, size_t c, int p):
+    bits(b), count(c), percentage(p), stride((b + 63) / 64),
+    order(byteOrder())
+  {
+    memcpy(magic, signature(), sizeof magic);
+    reserved[0] = reserved[1] = 0;
+  }
+};
+
+
+struct DistanceMatrix;
+
+// A population of BitVectors initialized from a stream or file, one
+// per line, where every line has as many bits as the first.  The
+// bits of all the BitVectors are in words, stride words per
+// BitVector, unless they are in a packed population file mapped in
+// file.  There is a problem with error on line when *this is false.
+//
+struct Population
+{
+  MappedFile file;
+  vector<uint64_t> words;
+  vector<BitVector> bitVectors;
+  int line;
+  string error;
+
+  operator bool() { return line == -1; }
+
+  // Add the length characters at s as bitvector n to the words in
+  // into.  Return false if they are not a bitvector as long as the
+  // others, and note the error.
+  //
+  bool add(int n, const char *s, size_t length, vector<uint64_t> &into) {
+    if (length == 0) {
+      line = n; error = "Empty line.";
+      return false;
+    }
+    if (n == 0) BitVector::initialize(length);
+    into.resize(into.size() + BitVector::stride);
+    uint64_t *const w = &into[into.size() - BitVector::stride];
+    if (length != BitVector::size || !BitVector::pack(w, s)) {
+      line = n; error.assign(s, length);
+      return false;
+    }
+    return true;
+  }
+
+  bool add(int n, const char *s, size_t length) {
+    return add(n, s, length, words);
+  }
+
+  // Append the bitvectors in batch to words, and point bitVectors at
+  // all of them wherever words now keeps them.
+  //
+  void append(const vector<uint64_t> &batch) {
+    const uint64_t *const old = words.empty() ? 0 : &words[0];
+    words.insert(words.end(), batch.begin(), batch.end());
+    if (words.empty()) return;
+    const uint64_t *const w = &words[0];
+    const size_t stride = BitVector::stride;
+    if (w != old) {
+      for (size_t i = 0; i < bitVectors.size(); ++i) {
+        bitVectors[i].bits = w + i * stride;
+      }
+    }
+    for (size_t i = bitVectors.size(); i < words.size() / stride; ++i) {
+      bitVectors.push_back(BitVector(i, w + i * stride));
+    }
+  }
+
+  // Point bitVectors at the n bitvectors of stride words each at w.
+  //
+  void index(int n, const uint64_t *w) {
+    if (n == 0) {
+      line = 0;
+      return;
+    }
+    bitVectors.reserve(n);
+    for (int i = 0; i < n; ++i) {
+      bitVectors.push_back(BitVector(i, w + i * BitVector::stride));
+    }
+  }
+
+  void index(int n) { index(n, words.empty() ? 0 : &words[0]); }
+
+  // Use the rows of a packed population file where they are mapped.
+  //
+  void unpack() {
+    const PackedHeader *const h =
+      reinterpret_cast<const PackedHeader *>(file.data);
+    BitVector::initialize(h->bits);
+    index(h->count, reinterpret_cast<const uint64_t *>(h + 1));
+  }
+
+  // Write this to s as a packed population file noting percentage.
+  // Return false if s fails.
+  //
+  bool pack(ostream &s, int percentage) const {
+    const PackedHeader h(BitVector::size, bitVectors.size(), percentage);
+    s.write(reinterpret_cast<const char *>(&h), sizeof h);
+    for (size_t n = 0; n < bitVectors.size(); ++n) {
+      s.write(reinterpret_cast<const char *>(bitVectors[n].bits),
+              BitVector::stride * sizeof(uint64_t));
+    }
+    return bool(s.flush());
+  }
+
+  // Read the lines of s.
+  //
+  void read(istream &s) {
+    string bitvector;
+    int n = 0;
+    for (; getline(s, bitvector); ++n) {
+      if (!add(n, bitvector.data(), bitvector.size())) return;
+    }
+    index(n);
+  }
+
+  // Read the lines of s in batches, each a quarter again as many as
+  // already read.  After each batch, matrix->extend() finds the
+  // distances of the batch to the rows before it on a thread of its
+  // own while the next batch is read.  Rows are only appended to
+  // words between batches, when no distances are being found.
+  //
+  template <typename Matrix>
+  void read(istream &s, Matrix *matrix) {
+    string bitvector;
+    vector<uint64_t> batch;
+    thread finding;
+    int n = 0;
+    for (bool more = true; more;) {
+      batch.clear();
+      for (const int last = n + max(4096, n / 4);
+           n < last && (more = bool(getline(s, bitvector))); ++n) {
+        if (!add(n, bitvector.data(), bitvector.size(), batch)) break;
+      }
+      if (finding.joinable()) finding.join();
+      if (line != -1) return;
+      append(batch);
+      if (n > 0) finding = thread(&Matrix::extend, matrix);
+    }
+    if (finding.joinable()) finding.join();
+    if (n == 0) line = 0;
+  }
+
+  // Parse the lines of file where they are mapped, reserving words
+  // for as many lines as there would be were all like the first.
+  //
+  void parse(const MappedFile &file) {
+    const char *p = file.data;
+    const char *const end = file.data + file.size;
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    const size_t width = (eol ? eol : end) - p;
+    words.reserve((file.size / (width + 1) + 1) * ((width + 63) / 64));
+    int n = 0;
+    for (; p < end; ++n) {
+      eol = static_cast<const char *>(memchr(p, '\n', end - p));
+      if (!eol) eol = end;
+      if (!add(n, p, eol - p)) return;
+      p = eol + 1;
+    }
+    index(n);
+  }
+
+  // Load the population at path, noting any problem in line and
+  // error.  Map the file into memory to use in place if it is a
+  // packed population, or else to parse.  Otherwise, or if it is a
+  // gzip file, which is inflated on a thread of its own as it is
+  // read, read it as a stream, and unless matrix is 0, find the
+  // distances between its rows with matrix while reading it.
+  //
+  template <typename Matrix>
+  void load(const char *path, Matrix *matrix) {
+    file.open(path);
+    if (file && PackedHeader::matches(file.data, file.size)) {
+      file.advise(MADV_WILLNEED);
+      unpack();
+    } else if (file && PackedHeader::foreign(file.data, file.size)) {
+      line = 0; error = "Packed population of another byte order.";
+    } else if (file && PackedHeader::marks(file.data, file.size)) {
+      line = 0; error = "Truncated or corrupt packed population.";
+    } else if (file && Inflater::marks(file.data, file.size)) {
+      file.unmap();
+      Inflater inflater(path);
+      istream s(&inflater);
+      matrix ? read(s, matrix) : read(s);
+      if (inflater.failed) {
+        if (line == -1) line = bitVectors.size();
+        error = "Corrupt or truncated gzip data.";
+      }
+    } else if (file) {
+      file.advise(MADV_SEQUENTIAL);
+      parse(file);
+      file.unmap();
+    } else {
+      ifstream s(path);
+      matrix ? read(s, matrix) : read(s);
+    }
+  }
+
+  Population(): file(0), words(), bitVectors(), line(-1), error() {}
+
+  Population(istream &s): file(0), words(), bitVectors(), line(-1), error()
+  {
+    read(s);
+  }
+
+  // Take the count bitvectors of bits bits each packed in w.
+  //
+  Population(size_t bits, int count, vector<uint64_t> &w):
+    file(0), words(), bitVectors(), line(-1), error()
+  {
+    BitVector::initialize(bits);
+    words.swap(w);
+    index(count);
+  }
+
+  Population(const char *path):
+    file(0), words(), bitVectors(), line(-1), error()
+  {
+    load(path, static_cast<DistanceMatrix *>(0));
+  }
+};
+
+
+// A copy of the bitvectors in bitVectors for each Numa node, for as
+// long as this lasts, where task n copies them for node n on a thread
+// pinned there, so the pages of the copy are first touched there.
+// Threads on a node find its copy with local().
+//
+struct Replica
+{
+  static Replica *current;
+  const vector<BitVector> &bitVectors;
+  vector<vector<uint64_t> > words;
+  vector<vector<BitVector> > copies;
+
+  // Return the copy of bitVectors for the node of the calling thread,
+  // or bitVectors itself if it has none.
+  //
+  static const vector<BitVector> &local(const vector<BitVector> &bitVectors) {
+    const Replica *const r = current;
+    if (Numa::node < 0 || !r || &r->bitVectors != &bitVectors) {
+      return bitVectors;
+    }
+    return r->copies[Numa::node];
+  }
+
+  // Copy bitVectors for node n.
+  //
+  void operator()(size_t n) {
+    const Numa::Pin pin(n);
+    const size_t stride = BitVector::stride;
+    words[n].resize(bitVectors.size() * stride);
+    copies[n] = bitVectors;
+    for (size_t i = 0; i < bitVectors.size(); ++i) {
+      const uint64_t *const w = bitVectors[i].bits;
+      copy(w, w + stride, &words[n][i * stride]);
+      copies[n][i].bits = &words[n][i * stride];
+    }
+  }
+
+  // Copy bvs only if Numa::placement is REPLICATE and there are nodes
+  // to copy it to.
+  //
+  Replica(const vector<BitVector> &bvs):
+    bitVectors(bvs), words(Numa::nodes.size()), copies(Numa::nodes.size())
+  {
+    if (Numa::placement != Numa::REPLICATE || Numa::nodes.size() < 2) return;
+    const Stats::Phase phase("replicate");
+    vector<thread> copiers;
+    for (size_t n = 0; n < Numa::nodes.size(); ++n) {
+      copiers.push_back(thread(ref(*this), n));
+    }
+    for (size_t n = 0; n < copiers.size(); ++n) copiers[n].join();
+    current = this;
+  }
+
+  ~Replica() { if (current == this) current = 0; }
+
+private:
+  Replica(const Replica &);
+  Replica &operator=(const Replica &);
+};
+
+
+// Relation between two BitVectors, with indexes left and right, and
+// the normalized bit distance nbd between them.
+//
+struct Relation
+{
+  size_t nbd;
+  int left; int right;
+
+  // True if lhs is probably a closer relation than rhs.  Break ties
+  // by left and then by right, so that every way of finding a
+  // SpanningGraph settles on the same one.
+  //
+  friend bool operator<(const Relation &lhs, const Relation &rhs)
+  {
+    if (lhs.nbd != rhs.nbd) return lhs.nbd < rhs.nbd;
+    if (lhs.left != rhs.left) return lhs.left < rhs.left;
+    return lhs.right < rhs.right;
+  }
+
+  Relation(): nbd(0), left(0), right(0) {}
+  Relation(size_t d, int p, int c): nbd(d), left(p), right(c) {}
+};
+
+
+// A Relation packed into 64 bits, nbd in the top 16 bits and then
+// left and right in 24 bits each, when the population and its
+// bitvectors are small enough to fit().  Ordering the packed bits
+// orders CompactRelations by nbd, then left, then right, just as
+// Relations are ordered.
+//
+struct CompactRelation
+{
+  uint64_t key;
+
+  // True if the Relations of count bitvectors of bits bits fit.
+  //
+  static bool fits(size_t count, size_t bits) {
+    return count <= (size_t(1) << 24) && bits < (size_t(1) << 16);
+  }
+
+  operator Relation() const {
+    return Relation(key >> 48, (key >> 24) & 0xffffff, key & 0xffffff);
+  }
+
+  friend bool operator<(const CompactRelation &lhs, const CompactRelation &rhs)
+  {
+    return lhs.key < rhs.key;
+  }
+
+  CompactRelation(): key(0) {}
+  CompactRelation(size_t d, int p, int c):
+    key(uint64_t(d) << 48 | uint64_t(p) << 24 | uint64_t(c)) {}
+};
+
+
+// The vertexes of a ConnectedGraph.  They are bitvector indexes, so
+// keep them as a bitmap over the indexes and a count of those in it,
+// rather than as a node per vertex.
+//
+struct Vertexes
+{
+  vector<uint64_t> words;
+  size_t count;
+
+  // Return the count of vertexes in this.
+  //
+  size_t size() const { return count; }
+
+  // Add v, which is not negative, to this.
+  //
+  void insert(int v) {
+    const size_t w = size_t(v) / 64;
+    if (w >= words.size()) words.resize(max(w + 1, 2 * words.size()), 0);
+    const uint64_t bit = uint64_t(1) << v % 64;
+    if (!(words[w] & bit)) { words[w] |= bit; ++count; }
+  }
+
+  Vertexes(): words(), count(0) {}
+};
+
+
+// A disjoint-set forest over bitvector indexes with path compression
+// and union by rank, so finding the subgraph containing a bitvector
+// and joining two subgraphs both cost nearly constant time.
+//
+struct DisjointSet
+{
+  vector<int> parent;
+  vector<unsigned char> rank;
+  size_t sets;
+
+  // Return the representative of the subgraph containing v.
+  //
+  int find(int v) {
+    while (parent[v] != v) {
+      parent[v] = parent[parent[v]];
+      v = parent[v];
+    }
+    return v;
+  }
+
+  // Join the subgraphs containing a and b.  Return true if they were
+  // disjoint.  Otherwise return false because joining them would
+  // close a cycle.
+  //
+  bool join(int a, int b) {
+    a = find(a); b = find(b);
+    if (a == b) return false;
+    if (rank[a] < rank[b]) swap(a, b);
+    parent[b] = a;
+    if (rank[a] == rank[b]) ++rank[a];
+    --sets;
+    return true;
+  }
+
+  DisjointSet(size_t size): parent(size), rank(size, 0), sets(size)
+  {
+    for (size_t n = 0; n < size; ++n) parent[n] = n;
+  }
+};
+
+
+// What a spanning graph saved by --save-tree was found from: the
+// mutation percentage, and a digest of the bits of the first count
+// bitvectors of its population, which it spans.  It is written as a
+// line of its own before the graph, so that --incremental can refuse
+// a tree of other bitvectors or another percentage.
+//
+struct TreeHeader
+{
+  int percentage;
+  uint64_t digest;
+
+  // Return a digest of the bits of the first count of bitVectors.
+  //
+  static uint64_t of(const vector<BitVector> &bitVectors, size_t count) {
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < count; ++i) {
+      const uint64_t *const w = bitVectors[i].bits;
+      for (size_t k = 0; k < BitVector::stride; ++k) {
+        result = (result ^ w[k]) * 0x100000001b3ULL;
+      }
+    }
+    return result;
+  }
+
+  friend bool operator==(const TreeHeader &lhs, const TreeHeader &rhs) {
+    return lhs.percentage == rhs.percentage && lhs.digest == rhs.digest;
+  }
+
+  friend ostream &operator<<(ostream &s, const TreeHeader &h) {
+    return s << "bvg-tree " << h.percentage << ' ' << h.digest << '\n';
+  }
+
+  // Read a header written by operator<<, failing s if it is not one.
+  //
+  friend istream &operator>>(istream &s, TreeHeader &h) {
+    string word;
+    if (s >> word >> h.percentage >> h.digest && word != "bvg-tree") {
+      s.setstate(ios::failbit);
+    }
+    return s;
+  }
+
+  TreeHeader(): percentage(-1), digest(0) {}
+
+  TreeHeader(const vector<BitVector> &bitVectors, size_t count):
+    percentage(BitVector::mutationPercentage),
+    digest(of(bitVectors, count))
+  {}
+};
+
+
+// A connected graph of Relations built while constructing a
+// SpanningGraph.
+//
+struct ConnectedGraph
+{
+  Vertexes vertexes;
+  vector<Relation> edges;
+
+  // Add e to this.
+  //
+  void add(const Relation &e) {
+    vertexes.insert(e.left);
+    vertexes.insert(e.right);
+    edges.push_back(e);
+  }
+
+  // Return the sum of the nbds of the edges.
+  //
+  size_t total() const {
+    typedef vector<Relation>::const_iterator Rp;
+    size_t result = 0;
+    for (Rp pE = edges.begin(); pE != edges.end(); ++pE) result += pE->nbd;
+    return result;
+  }
+
+  // Write the count of vertexes, then the left and right of each
+  // edge, one edge per line in Relation order, so that the same
+  // graph is always written the same way.
+  //
+  friend ostream &operator<<(ostream &s, const ConnectedGraph &g) {
+    typedef vector<Relation>::const_iterator Rp;
+    vector<Relation> edges(g.edges);
+    sort(edges.begin(), edges.end());
+    s << g.vertexes.size() << '\n';
+    for (Rp pE = edges.begin(); pE != edges.end(); ++pE) {
+      s << pE->left << ' ' << pE->right << '\n';
+    }
+    return s;
+  }
+
+  // Read a tree written by operator<<.  Fail s unless the edges
+  // connect all the vertexes from 0 to one less than their count,
+  // each joining two subgraphs the edges before it did not, so that
+  // they are a spanning tree.
+  //
+  friend istream &operator>>(istream &s, ConnectedGraph &g) {
+    g = ConnectedGraph();
+    size_t count = 0;
+    int left, right;
+    s >> count;
+    for (size_t n = 1; n < count && s >> left >> right; ++n) {
+      if (left < 0 || right < 0 || size_t(left) >= count
+          || size_t(right) >= count) {
+        break;
+      }
+      g.add(Relation(0, left, right));
+    }
+    bool tree = g.edges.size() + 1 == count && g.vertexes.size() == count;
+    if (tree) {
+      DisjointSet forest(count);
+      for (size_t n = 0; tree && n < g.edges.size(); ++n) {
+        tree = forest.join(g.edges[n].left, g.edges[n].right);
+      }
+    }
+    if (!tree) s.setstate(ios::failbit);
+    return s;
+  }
+
+  ConnectedGraph(): vertexes(), edges() {}
+};
+
+
+// Call put(i, j, n) for each row i from top up to bottom and column j
+// from left up to right of bitVectors, where n is the number of bits
+// different between bitvectors i and j, and j is less than i if below
+// is true, or greater than i if not.  Count whole blocks of BLOCK
+// rows by BLOCK columns at once unless BitVector::tiling is NAIVE.
+//
+template <typename Put>
+static void countTile(const vector<BitVector> &bitVectors,
+                      size_t top, size_t bottom, size_t left, size_t right,
+                      bool below, Put &put)
+{
+  const size_t B = BitVector::BLOCK;
+  if (BitVector::tiling == BitVector::NAIVE) {
+    for (size_t i = top; i < bottom; ++i) {
+      const uint64_t *const lhs = bitVectors[i].bits;
+      const size_t begin = below ? left : max(left, i + 1);
+      const size_t end = below ? min(right, i) : right;
+      for (size_t j = begin; j < end; ++j) {
+        put(i, j, BitVector::count(lhs, bitVectors[j].bits));
+      }
+    }
+    return;
+  }
+  for (size_t i = top; i < bottom; i += B) {
+    const size_t rows = min(B, bottom - i);
+    const uint64_t *lhs[B];
+    for (size_t a = 0; a < rows; ++a) lhs[a] = bitVectors[i + a].bits;
+    for (size_t j = left; j < right; j += B) {
+      const size_t columns = min(B, right - j);
+      const uint64_t *rhs[B];
+      for (size_t b = 0; b < columns; ++b) rhs[b] = bitVectors[j + b].bits;
+      if (rows == B && columns == B && (below ? j + B <= i : i + B <= j)) {
+        size_t counts[B * B];
+        BitVector::countBlock(lhs, rhs, counts);
+        for (size_t a = 0; a < B; ++a) {
+          for (size_t b = 0; b < B; ++b) put(i + a, j + b, counts[a * B + b]);
+        }
+        continue;
+      }
+      for (size_t a = 0; a < rows; ++a) {
+        for (size_t b = 0; b < columns; ++b) {
+          if (below ? j + b < i + a : j + b > i + a) {
+            put(i + a, j + b, BitVector::count(lhs[a], rhs[b]));
+          }
+        }
+      }
+    }
+  }
+}
+
+
+// The number of bits different between every pair of bitvectors in
+// a population, before normalizing, in 16 bits each.  Row i holds
+// the distances from bitvector i to bitvectors 0 to i - 1, so row i
+// is at offset(i), and rows can be added as bitvectors are.  Rows
+// are found in tiles of rows and columns on Workers, the same way
+// SpanningGraph::findAll() finds relations.  The first rows rows
+// have been found.
+//
+struct DistanceMatrix
+{
+  const vector<BitVector> &bitVectors;
+  vector<uint16_t> distances;
+  size_t rows;
+  size_t side;
+  vector<pair<size_t, size_t> > tiles;
+
+  // True if distances between bitvectors of bits bits fit.
+  //
+  static bool fits(size_t bits) { return bits < (size_t(1) << 16); }
+
+  // Return the offset in distances of row i.
+  //
+  static size_t offset(size_t i) { return i * (i - 1) / 2; }
+
+  // Return the first of the rows in slice n of chunks slices of the
+  // rows of size bitvectors, such that each slice holds about as
+  // many distances as any other.
+  //
+  static size_t slice(size_t size, size_t n, size_t chunks) {
+    if (n >= chunks) return size;
+    return min(size, size_t(size * sqrt(double(n) / chunks)));
+  }
+
+  // Find the distances in tile n.
+  //
+  void operator()(size_t n) {
+    const size_t size = bitVectors.size();
+    const size_t top = tiles[n].first, left = tiles[n].second;
+    const size_t bottom = min(size, top + side);
+    countTile(Replica::local(bitVectors), top, bottom, left, min(bottom, left + side),
+              true, *this);
+  }
+
+  // Note the count of bits different between rows i and j.
+  //
+  void operator()(size_t i, size_t j, size_t count) {
+    distances[offset(i) + j] = count;
+  }
+
+  // Find the rows of the bitvectors added to population since the
+  // last rows were found, if distances between them fit.
+  //
+  void extend() {
+    const size_t size = bitVectors.size();
+    if (!fits(BitVector::size) || rows >= size) return;
+    distances.resize(offset(size));
+    side = max<size_t>(16, (256 << 10) / (8 * BitVector::stride));
+    tiles.clear();
+    for (size_t top = rows; top < size; top += side) {
+      for (size_t left = 0; left < min(size, top + side); left += side) {
+        tiles.push_back(make_pair(top, left));
+      }
+    }
+    Workers::run(tiles.size(), *this);
+    rows = size;
+  }
+
+  // Find no rows of population yet.
+  //
+  DistanceMatrix(const Population &population):
+    bitVectors(population.bitVectors), distances(), rows(0), side(0),
+    tiles()
+  {}
+};
+
+
+// A undirected graph spanning all bitvectors and minimizing the
+// Relation distance between connected bitvectors.  When result does
+// not span them all, there may be a problem with error.
+//
+struct SpanningGraph
+{
+  size_t size;
+  ConnectedGraph result;
+  string error;
+
+  // The relations of rows first up to last of bitVectors to all later
+  // rows, cut into square tiles of side rows by side columns, such
+  // that the bits of a tile's rows and columns stay in cache while
+  // its relations are found.  Each tile writes its relations to their
+  // place in relations, which holds the relations of row first to
+  // all later rows, then of the next row to all later rows, and so
+  // on, as Relations or CompactRelations.
+  //
+  template <typename R>
+  struct Tiles
+  {
+    const vector<BitVector> &bitVectors;
+    vector<R> &relations;
+    const size_t expected;
+    size_t first, last;
+    size_t side;
+    vector<pair<size_t, size_t> > tiles;
+
+    // Return the offset in all the relations of row left to all later
+    // rows.
+    //
+    size_t start(size_t left) {
+      const size_t size = bitVectors.size();
+      return left * (2 * size - left - 1) / 2;
+    }
+
+    // Return the offset in relations of the relation between rows
+    // left and right where left < right.
+    //
+    size_t offset(size_t left, size_t right) {
+      return start(left) - start(first) + right - left - 1;
+    }
+
+    // Find the relations in tile n.
+    //
+    void operator()(size_t n) {
+      const size_t size = bitVectors.size();
+      const size_t top = tiles[n].first, left = tiles[n].second;
+      countTile(Replica::local(bitVectors), top, min(last, top + side),
+                left, min(size, left + side), false, *this);
+    }
+
+    // Note the relation of rows i and j from the count of bits
+    // different between them.
+    //
+    void operator()(size_t i, size_t j, size_t count) {
+      relations[offset(i, j)] = R(BitVector::normalize(count, expected),
+                                  bitVectors[i].index, bitVectors[j].index);
+    }
+
+    // Keep the bits of a tile's rows and columns within about 512K,
+    // and the expected mutation count where the compiler can keep it
+    // in a register across the tile.
+    //
+    Tiles(const vector<BitVector> &bvs, vector<R> &rs, size_t f, size_t l):
+      bitVectors(bvs), relations(rs), expected(BitVector::expected),
+      first(f), last(l),
+      side(max<size_t>(16, (256 << 10) / (8 * BitVector::stride))),
+      tiles()
+    {
+      const size_t size = bitVectors.size();
+      for (size_t top = first; top < last; top += side) {
+        for (size_t left = top; left < size; left += side) {
+          tiles.push_back(make_pair(top, left));
+        }
+      }
+    }
+  };
+
+  // Return all the relations in population.
+  //
+  template <typename R>
+  static vector<R> findAll(const Population &population)
+  {
+    Stats::Phase phase("relations");
+    const size_t size = population.bitVectors.size();
+    vector<R> result(size * (size - 1) / 2);
+    Tiles<R> tiles(population.bitVectors, result, 0, size);
+    Workers::run(tiles.tiles.size(), tiles);
+    Stats::count("relations", result.size());
+    return result;
+  }
+
+  // The ways to sort relations by nbd: a counting sort (COUNTING),
+  // or std::sort() for comparison (STANDARD).
+  //
+  enum Sorter { COUNTING, STANDARD };
+  static Sorter sorter;
+
+  // A stable counting sort of input into output by nbd, where each
+  // of chunks tasks counts the nbds in one slice of input, then,
+  // once counts holds where each slice's relations of each nbd go,
+  // copies them there.  The relations with nbd n end up from
+  // starts[n] up to starts[n + 1] in output.
+  //
+  template <typename R>
+  struct CountingSort
+  {
+    const vector<R> &input;
+    vector<R> &output;
+    size_t chunks;
+    size_t limit;
+    vector<size_t> counts;
+    vector<size_t> starts;
+    bool placing;
+
+    // Count or place the relations in slice n of input.
+    //
+    void operator()(size_t n) {
+      const size_t begin = input.size() * n / chunks;
+      const size_t end = input.size() * (n + 1) / chunks;
+      size_t *const count = &counts[n * limit];
+      if (placing) {
+        for (size_t i = begin; i < end; ++i) {
+          output[count[Relation(input[i]).nbd]++] = input[i];
+        }
+      } else {
+        for (size_t i = begin; i < end; ++i) ++count[Relation(input[i]).nbd];
+      }
+    }
+
+    // Turn counts into the offsets in output of the first relation
+    // of each nbd in each slice.
+    //
+    void offsets() {
+      size_t total = 0;
+      for (size_t nbd = 0; nbd < limit; ++nbd) {
+        starts[nbd] = total;
+        for (size_t n = 0; n < chunks; ++n) {
+          const size_t count = counts[n * limit + nbd];
+          counts[n * limit + nbd] = total;
+          total += count;
+        }
+      }
+      starts[limit] = total;
+    }
+
+    // No nbd is more than the number of bits in a BitVector.
+    //
+    CountingSort(const vector<R> &i, vector<R> &o):
+      input(i), output(o), chunks(Workers::threads),
+      limit(BitVector::size + 1), counts(chunks * limit, 0),
+      starts(limit + 1), placing(false)
+    {
+      Workers::run(chunks, *this);
+      offsets();
+      placing = true;
+      Workers::run(chunks, *this);
+    }
+  };
+
+  // Sort the relations with nbd n, from starts[n] up to
+  // starts[n + 1], by left and then right in task n.
+  //
+  template <typename R>
+  struct Ties
+  {
+    vector<R> &relations;
+    const vector<size_t> &starts;
+
+    void operator()(size_t n) {
+      sort(relations.begin() + starts[n], relations.begin() + starts[n + 1]);
+    }
+
+    Ties(vector<R> &rs, const vector<size_t> &ss):
+      relations(rs), starts(ss)
+    {
+      Workers::run(starts.size() - 1, *this);
+    }
+  };
+
+  // Sort relations with sorter.  The counting sort is stable, so
+  // when ordered says relations are already by left and then right,
+  // relations with the same nbd stay that way.  Otherwise they are
+  // sorted again.
+  //
+  template <typename R>
+  static void sortAll(vector<R> &relations, bool ordered = true)
+  {
+    Stats::Phase phase("sort");
+    if (sorter == STANDARD) {
+      sort(relations.begin(), relations.end());
+    } else {
+      vector<R> sorted(relations.size());
+      const CountingSort<R> counting(relations, sorted);
+      relations.swap(sorted);
+      if (!ordered) Ties<R>(relations, counting.starts);
+    }
+  }
+
+  // Store relations for kruskal() as Relations (WIDE) or, when they
+  // fit, as CompactRelations of half the size (COMPACT).
+  //
+  enum Storage { WIDE, COMPACT };
+  static Storage storage;
+
+#ifdef BVG_GPU
+
+  // Where Outside finds closest relations instead of on Workers, if
+  // not 0.
+  //
+  static Device *device;
+
+#endif
+
+  // Take the closest of the sorted relations first, keeping each one
+  // that joins two subgraphs of forest, until a single subgraph
+  // remains.
+  //
+  template <typename R>
+  void join(const vector<R> &relations, DisjointSet &forest)
+  {
+    Stats::Phase phase("join");
+    typedef typename vector<R>::const_iterator Rp;
+    Rp pR = relations.begin();
+    for (; forest.sets > 1 && pR != relations.end(); ++pR) {
+      const Relation r(*pR);
+      if (forest.join(r.left, r.right)) result.add(r);
+    }
+    Stats::count("relations_examined", pR - relations.begin());
+  }
+
+  template <typename R>
+  void join(const vector<R> &relations)
+  {
+    DisjointSet forest(size);
+    join(relations, forest);
+  }
+
+  // The most bytes kruskal() may keep relations in before it spills
+  // sorted runs of them to disk instead, or 0 for no limit.
+  //
+  static size_t memoryBudget;
+
+  // Sorted runs of relations written one after another to an unlinked
+  // temporary file in TMPDIR or /tmp, where run n starts at starts[n]
+  // relations in.  *this is false if the file cannot be made.
+  //
+  template <typename R>
+  struct Spill
+  {
+    int fd;
+    vector<size_t> starts;
+
+    operator bool() const { return fd >= 0; }
+
+    // Append relations as another run.  Return false if that fails.
+    //
+    bool write(const vector<R> &relations) {
+      const char *p = reinterpret_cast<const char *>(&relations[0]);
+      size_t left = relations.size() * sizeof(R);
+      while (left > 0) {
+        const ssize_t n = ::write(fd, p, left);
+        if (n <= 0) return false;
+        p += n; left -= n;
+      }
+      starts.push_back(starts.back() + relations.size());
+      return true;
+    }
+
+    Spill(): fd(-1), starts(1, 0)
+    {
+      const char *const dir = getenv("TMPDIR");
+      string path = string(dir && *dir ? dir : "/tmp") + "/bvg-XXXXXX";
+      fd = mkstemp(&path[0]);
+      if (fd >= 0) unlink(path.c_str());
+    }
+
+    ~Spill() { if (fd >= 0) close(fd); }
+
+  private:
+    Spill(const Spill &);
+    Spill &operator=(const Spill &);
+  };
+
+  // A place in a run of a Spill from at up to end, read into buffer
+  // a piece of up to most relations at a time.  *this is false when
+  // the run is used up, or cannot be read.
+  //
+  template <typename R>
+  struct Cursor
+  {
+    int fd;
+    size_t at, end, most, next;
+    vector<R> buffer;
+
+    operator bool() const { return next < buffer.size(); }
+
+    const R &front() const { return buffer[next]; }
+
+    // Read the next piece of the run into buffer.
+    //
+    void refill() {
+      buffer.resize(min(most, end - at));
+      next = 0;
+      char *p = reinterpret_cast<char *>(buffer.empty() ? 0 : &buffer[0]);
+      size_t left = buffer.size() * sizeof(R);
+      off_t offset = at * sizeof(R);
+      while (left > 0) {
+        const ssize_t n = pread(fd, p, left, offset);
+        if (n <= 0) { buffer.clear(); return; }
+        p += n; left -= n; offset += n;
+      }
+      at += buffer.size();
+    }
+
+    void advance() { if (++next == buffer.size()) refill(); }
+
+    Cursor(int f, size_t a, size_t e, size_t m):
+      fd(f), at(a), end(e), most(m), next(0), buffer()
+    {
+      refill();
+    }
+  };
+
+  // Orders the indexes of Cursors by the relations at their fronts,
+  // closest last, for a priority_queue.
+  //
+  template <typename R>
+  struct Later
+  {
+    const vector<Cursor<R> > *cursors;
+
+    bool operator()(size_t lhs, size_t rhs) const {
+      return (*cursors)[rhs].front() < (*cursors)[lhs].front();
+    }
+
+    Later(const vector<Cursor<R> > &cs): cursors(&cs) {}
+  };
+
+  // Like kruskal(), but find and sort the relations a slice of rows at
+  // a time, so that a slice's relations fit in memoryBudget even as
+  // they are sorted, and spill each slice as a sorted run.  Then merge
+  // the runs, reading each into a buffer of its share of memoryBudget,
+  // and join relations as they come, stopping as soon as a single
+  // subgraph remains.
+  //
+  template <typename R>
+  void external(const Population &population)
+  {
+    const vector<BitVector> &bitVectors = population.bitVectors;
+    const size_t most = max<size_t>(memoryBudget / (2 * sizeof(R)), size);
+    Stats::Phase spilling("spill");
+    Spill<R> spill;
+    if (!spill) {
+      error = "Cannot make a temporary file to spill relations to.";
+      return;
+    }
+    for (size_t first = 0, last = 0; first < size; first = last) {
+      size_t count = 0;
+      for (; last < size && count + size - 1 - last <= most; ++last) {
+        count += size - 1 - last;
+      }
+      vector<R> relations(count);
+      Tiles<R> tiles(bitVectors, relations, first, last);
+      Workers::run(tiles.tiles.size(), tiles);
+      sortAll(relations);
+      if (count && !spill.write(relations)) {
+        error = "Cannot spill relations to a temporary file.";
+        return;
+      }
+    }
+    const size_t runs = spill.starts.size() - 1;
+    Stats::count("relations", spill.starts.back());
+    Stats::count("runs", runs);
+    spilling.end();
+    Stats::Phase merging("merge");
+    const size_t piece = max<size_t>(1, memoryBudget / sizeof(R) / runs);
+    vector<Cursor<R> > cursors;
+    for (size_t n = 0; n < runs; ++n) {
+      cursors.push_back(Cursor<R>(spill.fd, spill.starts[n],
+                                  spill.starts[n + 1], piece));
+    }
+    priority_queue<size_t, vector<size_t>, Later<R> > heap((Later<R>(cursors)));
+    for (size_t n = 0; n < runs; ++n) {
+      if (!cursors[n]) {
+        error = "Cannot read relations back from a temporary file.";
+        return;
+      }
+      heap.push(n);
+    }
+    DisjointSet forest(size);
+    uint64_t examined = 0;
+    while (forest.sets > 1 && !heap.empty()) {
+      Cursor<R> &cursor = cursors[heap.top()];
+      const Relation r(cursor.front());
+      ++examined;
+      if (forest.join(r.left, r.right)) result.add(r);
+      const size_t n = heap.top();
+      heap.pop();
+      cursor.advance();
+      if (cursor) {
+        heap.push(n);
+      } else if (cursor.at < cursor.end) {
+        error = "Cannot read relations back from a temporary file.";
+        return;
+      }
+    }
+    Stats::count("relations_examined", examined);
+  }
+
+  template <typename R>
+  void kruskal(const Population &population)
+  {
+    const size_t count = size * (size - 1) / 2;
+    if (memoryBudget && 2 * count * sizeof(R) > memoryBudget) {
+      external<R>(population);
+      return;
+    }
+    vector<R> relations(findAll<R>(population));
+    sortAll(relations);
+    join(relations);
+  }
+
+  void kruskal(const Population &population)
+  {
+    const size_t count = population.bitVectors.size();
+    if (storage == COMPACT && CompactRelation::fits(count, BitVector::size)) {
+      kruskal<CompactRelation>(population);
+    } else {
+      kruskal<Relation>(population);
+    }
+  }
+
+  // Grow a single tree from the first bitvector, each time adding
+  // the closest relation between the tree and some bitvector not yet
+  // in it.  Keep only the closest known relation to each outside
+  // bitvector in nearest, and compute distances as they are needed,
+  // so no more than O(size) relations are ever stored.
+  //
+  void prim(const Population &population)
+  {
+    Stats::Phase phase("prim");
+    const vector<BitVector> &bitVectors = population.bitVectors;
+    const int size = bitVectors.size();
+    if (size == 0) return;
+    vector<Relation> nearest(size);
+    vector<bool> inTree(size, false);
+    inTree[0] = true;
+    for (int n = 1; n < size; ++n) {
+      nearest[n] = Relation(bitVectors[0] - bitVectors[n], 0, n);
+    }
+    for (int added = 1; added < size; ++added) {
+      int best = -1;
+      for (int n = 1; n < size; ++n) {
+        if (!inTree[n]) {
+          if (best < 0 || nearest[n] < nearest[best]) best = n;
+        }
+      }
+      inTree[best] = true;
+      result.add(nearest[best]);
+      const BitVector &bv = bitVectors[best];
+      for (int n = 1; n < size; ++n) {
+        if (!inTree[n]) {
+          const size_t nbd = BitVector::within(bv, bitVectors[n],
+                                               nearest[n].nbd);
+          const Relation r(nbd, min(best, n), max(best, n));
+          if (r < nearest[n]) nearest[n] = r;
+        }
+      }
+    }
+  }
+
+  // *this is true when the result graph spans all the bitvectors.
+  // Otherwise false.
+  //
+  operator bool() { return result.vertexes.size() == size; }
+
+  // The relations from a DistanceMatrix with nbd from low up to but
+  // not including high, where each of chunks tasks puts the pairs
+  // in its slice of rows into buckets by nbd.  The pairs are packed
+  // with the lower index in the upper 32 bits.
+  //
+  struct Window
+  {
+    const DistanceMatrix &matrix;
+    size_t low, high, chunks;
+    vector<int> bucketOf;
+    vector<vector<vector<uint64_t> > > buckets;
+
+    // Bucket the pairs in slice n of the matrix rows.
+    //
+    void operator()(size_t n) {
+      const size_t size = matrix.bitVectors.size();
+      const size_t end = DistanceMatrix::slice(size, n + 1, chunks);
+      vector<vector<uint64_t> > &bucket = buckets[n];
+      for (size_t i = DistanceMatrix::slice(size, n, chunks); i < end; ++i) {
+        const uint16_t *const row = &matrix.distances[matrix.offset(i)];
+        for (size_t j = 0; j < i; ++j) {
+          const int b = bucketOf[row[j]];
+          if (b >= 0) bucket[b].push_back(uint64_t(j) << 32 | i);
+        }
+      }
+    }
+
+    // Look up the bucket of each distance instead of normalizing it.
+    //
+    Window(const DistanceMatrix &m, size_t l, size_t h):
+      matrix(m), low(l), high(h), chunks(4 * Workers::threads),
+      bucketOf(BitVector::size + 1, -1),
+      buckets(chunks, vector<vector<uint64_t> >(high - low))
+    {
+      for (size_t d = 0; d < bucketOf.size(); ++d) {
+        const size_t nbd = BitVector::normalize(d);
+        if (nbd >= low && nbd < high) bucketOf[d] = nbd - low;
+      }
+      Workers::run(chunks, *this);
+    }
+  };
+
+  // Where lazy() saves its progress, unless checkpoint is 0, at most
+  // every checkpointInterval seconds, and whether it resumes from
+  // what it saved there before.
+  //
+  static const char *checkpoint;
+  static double checkpointInterval;
+  static bool resume;
+
+  // The progress of lazy() on population saved at path: its raw
+  // distances, saved to path once they are all found, and how far it
+  // has joined them, saved to path.join now and then.  The join is
+  // saved as the window from low to low + span it is in and the next
+  // bucket of that window to join, with the forest and the edges so
+  // far.  Each file starts with the bits and count of the population
+  // and a digest of its bits, and is written beside itself then
+  // renamed into place, so a failure leaves the last one whole.
+  //
+  struct Checkpoint
+  {
+    const vector<BitVector> &bitVectors;
+    string path;
+    uint64_t header[6];
+
+    // Return a digest of the bits of bitVectors.
+    //
+    uint64_t digest() const {
+      return TreeHeader::of(bitVectors, bitVectors.size());
+    }
+
+    // Write the size bytes at each part of parts to a file at to.
+    // Return false if that fails.
+    //
+    static bool save(const string &to,
+                     const vector<pair<const void *, size_t> > &parts) {
+      const string temporary = to + ".tmp";
+      {
+        ofstream s(temporary.c_str(), ios::binary);
+        for (size_t n = 0; n < parts.size(); ++n) {
+          s.write(static_cast<const char *>(parts[n].first), parts[n].second);
+        }
+        if (!s.flush()) return false;
+      }
+      return rename(temporary.c_str(), to.c_str()) == 0;
+    }
+
+    // Read the size bytes of each part of parts from s.  Return false
+    // if s ends first.
+    //
+    static bool load(istream &s, const vector<pair<void *, size_t> > &parts) {
+      for (size_t n = 0; n < parts.size(); ++n) {
+        s.read(static_cast<char *>(parts[n].first), parts[n].second);
+      }
+      return bool(s);
+    }
+
+    // Save the distances in matrix.
+    //
+    bool save(const DistanceMatrix &matrix) const {
+      vector<pair<const void *, size_t> > parts;
+      parts.push_back(make_pair(header, sizeof header));
+      parts.push_back(make_pair(matrix.distances.data(),
+                                matrix.distances.size() * sizeof(uint16_t)));
+      return save(path, parts);
+    }
+
+    // Load the distances into matrix.  Return false if none were
+    // saved, and note in error if those saved are not of population.
+    //
+    bool load(DistanceMatrix &matrix, string &error) const {
+      ifstream s(path.c_str(), ios::binary);
+      if (!s) return false;
+      uint64_t h[6];
+      matrix.distances.resize(DistanceMatrix::offset(bitVectors.size()));
+      vector<pair<void *, size_t> > parts;
+      parts.push_back(make_pair(h, sizeof h));
+      parts.push_back(make_pair(matrix.distances.data(),
+                                matrix.distances.size() * sizeof(uint16_t)));
+      if (!load(s, parts) || memcmp(h, header, sizeof h) != 0) {
+        vector<uint16_t>().swap(matrix.distances);
+        error = "Checkpoint '" + path + "' is not of this population.";
+        return false;
+      }
+      matrix.rows = bitVectors.size();
+      return true;
+    }
+
+    // Save the join of forest into result up to the next bucket of the
+    // window from low to low + span.
+    //
+    bool save(size_t low, size_t span, size_t bucket,
+              const DisjointSet &forest, const ConnectedGraph &result) const {
+      const uint64_t state[5] = {
+        uint64_t(BitVector::mutationPercentage), low, span, bucket,
+        result.edges.size()
+      };
+      vector<pair<const void *, size_t> > parts;
+      parts.push_back(make_pair(header, sizeof header));
+      parts.push_back(make_pair(state, sizeof state));
+      parts.push_back(make_pair(forest.parent.data(),
+                                forest.parent.size() * sizeof(int)));
+      parts.push_back(make_pair(forest.rank.data(), forest.rank.size()));
+      parts.push_back(make_pair(result.edges.data(),
+                                result.edges.size() * sizeof(Relation)));
+      return save(path + ".join", parts);
+    }
+
+    // Load the join saved for this population with this mutation
+    // percentage into the others.  Return false if there is none, or
+    // if what was saved could not have been saved by lazy(): a window
+    // that is not one of those lazy() takes, an index out of range,
+    // an edge that does not join two subgraphs of those before it, or
+    // a forest with other than one subgraph per vertex not joined.
+    // The forest is then joined again from the edges.
+    //
+    bool load(size_t &low, size_t &span, size_t &bucket,
+              DisjointSet &forest, ConnectedGraph &result) const {
+      ifstream s((path + ".join").c_str(), ios::binary);
+      uint64_t h[6], state[5];
+      vector<pair<void *, size_t> > parts;
+      parts.push_back(make_pair(h, sizeof h));
+      parts.push_back(make_pair(state, sizeof state));
+      if (!load(s, parts) || memcmp(h, header, sizeof h) != 0
+          || state[0] != uint64_t(BitVector::mutationPercentage)
+          || state[4] >= bitVectors.size()) {
+        return false;
+      }
+      DisjointSet f(bitVectors.size());
+      vector<Relation> edges(state[4]);
+      parts.clear();
+      parts.push_back(make_pair(f.parent.data(), f.parent.size() * sizeof(int)));
+      parts.push_back(make_pair(f.rank.data(), f.rank.size()));
+      parts.push_back(make_pair(edges.data(), edges.size() * sizeof(Relation)));
+      const size_t size = bitVectors.size();
+      if (!load(s, parts) || state[2] < 16 || (state[2] & (state[2] - 1))
+          || state[1] + 16 != state[2] || state[3] > state[2]) {
+        return false;
+      }
+      size_t sets = 0;
+      for (size_t i = 0; i < size; ++i) {
+        if (f.parent[i] < 0 || size_t(f.parent[i]) >= size) return false;
+        sets += size_t(f.parent[i]) == i;
+      }
+      DisjointSet joined(size);
+      for (size_t n = 0; n < edges.size(); ++n) {
+        const Relation &e = edges[n];
+        if (e.left < 0 || e.right < 0 || size_t(e.left) >= size
+            || size_t(e.right) >= size || !joined.join(e.left, e.right)) {
+          return false;
+        }
+      }
+      if (sets != joined.sets) return false;
+      swap(forest, joined);
+      result = ConnectedGraph();
+      for (size_t n = 0; n < edges.size(); ++n) result.add(edges[n]);
+      low = state[1]; span = state[2]; bucket = state[3];
+      return true;
+    }
+
+    Checkpoint(const vector<BitVector> &bvs, const char *p):
+      bitVectors(bvs), path(p)
+    {
+      const uint64_t h[6] = {
+        0x3154504b43475642ULL, BitVector::size, bitVectors.size(),
+        path.empty() ? 0 : digest(), 0, 0
+      };
+      copy(h, h + 6, header);
+    }
+  };
+
+  // Like kruskal(), but find only the raw distances up front, in
+  // matrix, which may already hold some of them, then take relations
+  // from it a Window of nbds at a time, doubling the window each
+  // time, and stop as soon as a single subgraph remains.  Sorting the
+  // packed pairs of each bucket orders them as Relations are ordered.
+  // No relation with an nbd past that window is ever stored, and each
+  // bucket is freed once joined.
+  //
+  void lazy(const Population &population, DistanceMatrix &matrix)
+  {
+    if (!DistanceMatrix::fits(BitVector::size)) return kruskal(population);
+    Stats::Phase finding("distances");
+    const Checkpoint saved(population.bitVectors, checkpoint ? checkpoint : "");
+    const bool resumed = checkpoint && resume && saved.load(matrix, error);
+    if (!error.empty()) return;
+    if (!resumed) {
+      matrix.extend();
+      if (checkpoint && !saved.save(matrix)) {
+        error = "Cannot write checkpoint '" + saved.path + "'.";
+        return;
+      }
+    }
+    finding.end();
+    Stats::Phase phase("join");
+    DisjointSet forest(population.bitVectors.size());
+    size_t low = 0, span = 16, first = 0;
+    if (resumed) saved.load(low, span, first, forest, result);
+    double last = Stats::wall();
+    uint64_t examined = 0;
+    for (; forest.sets > 1 && low <= BitVector::size; first = 0) {
+      Window window(matrix, low, low + span);
+      Stats::count("windows", 1);
+      for (size_t b = first; forest.sets > 1 && b < span; ++b) {
+        vector<uint64_t> bucket;
+        for (size_t n = 0; n < window.chunks; ++n) {
+          vector<uint64_t> &chunk = window.buckets[n][b];
+          bucket.insert(bucket.end(), chunk.begin(), chunk.end());
+          vector<uint64_t>().swap(chunk);
+        }
+        sort(bucket.begin(), bucket.end());
+        size_t p = 0;
+        for (; forest.sets > 1 && p < bucket.size(); ++p) {
+          const int left = bucket[p] >> 32, right = bucket[p] & 0xffffffff;
+          if (forest.join(left, right)) {
+            result.add(Relation(low + b, left, right));
+          }
+        }
+        examined += p;
+        if (checkpoint && Stats::wall() - last >= checkpointInterval) {
+          if (!saved.save(low, span, b + 1, forest, result)) {
+            error = "Cannot write checkpoint '" + saved.path + ".join'.";
+            return;
+          }
+          last = Stats::wall();
+        }
+      }
+      low += span; span *= 2;
+    }
+    Stats::count("relations_examined", examined);
+  }
+
+  // The number of hash tables, and of bits sampled for each hash,
+  // that approximate() uses to find candidate relations.
+  //
+  static size_t hashTables;
+  static size_t hashBits;
+
+  // Pairs of bitvectors likely to differ in few bits, found by
+  // bit-sampling locality-sensitive hashing.  Task n hashes every
+  // bitvector by the hashBits bits at random positions drawn for
+  // table n, sorts the bitvectors by hash, then pairs each one with
+  // up to window of those after it with the same hash.  Each pair
+  // is packed with the lower index in the upper 32 bits.
+  //
+  struct Candidates
+  {
+    static const size_t window = 8;
+    const vector<BitVector> &bitVectors;
+    vector<vector<uint64_t> > pairs;
+
+    void operator()(size_t n) {
+      const size_t size = bitVectors.size();
+      Random random(n + 1);
+      vector<size_t> positions(hashBits);
+      for (size_t b = 0; b < hashBits; ++b) {
+        positions[b] = random() % BitVector::size;
+      }
+      vector<uint64_t> keys(size);
+      for (size_t i = 0; i < size; ++i) {
+        const uint64_t *const bits = bitVectors[i].bits;
+        uint64_t hash = 0;
+        for (size_t b = 0; b < hashBits; ++b) {
+          hash = hash << 1 | (bits[positions[b] / 64] >> positions[b] % 64 & 1);
+        }
+        keys[i] = hash << 32 | i;
+      }
+      sort(keys.begin(), keys.end());
+      for (size_t i = 0; i < size; ++i) {
+        const size_t end = min(size, i + 1 + window);
+        for (size_t j = i + 1; j < end && keys[j] >> 32 == keys[i] >> 32; ++j) {
+          const uint64_t a = keys[i] & 0xffffffff, b = keys[j] & 0xffffffff;
+          pairs[n].push_back(min(a, b) << 32 | max(a, b));
+        }
+      }
+    }
+
+    // Return the pairs of all tables, each pair only once.
+    //
+    vector<uint64_t> all() {
+      vector<uint64_t> result;
+      for (size_t n = 0; n < pairs.size(); ++n) {
+        result.insert(result.end(), pairs[n].begin(), pairs[n].end());
+        vector<uint64_t>().swap(pairs[n]);
+      }
+      sort(result.begin(), result.end());
+      result.erase(unique(result.begin(), result.end()), result.end());
+      return result;
+    }
+
+    Candidates(const vector<BitVector> &bvs):
+      bitVectors(bvs), pairs(hashTables)
+    {
+      Workers::run(hashTables, *this);
+    }
+  };
+
+  // The Relations of packed pairs, where each of chunks tasks finds
+  // those of one slice of pairs.
+  //
+  struct Measure
+  {
+    const vector<BitVector> &bitVectors;
+    const vector<uint64_t> &pairs;
+    vector<Relation> relations;
+    size_t chunks;
+
+    void operator()(size_t n) {
+      const vector<BitVector> &bvs = Replica::local(bitVectors);
+      const size_t end = pairs.size() * (n + 1) / chunks;
+      for (size_t i = pairs.size() * n / chunks; i < end; ++i) {
+        const int left = pairs[i] >> 32, right = pairs[i] & 0xffffffff;
+        relations[i] = Relation(bvs[left] - bvs[right], left, right);
+      }
+    }
+
+    Measure(const vector<BitVector> &bvs, const vector<uint64_t> &ps):
+      bitVectors(bvs), pairs(ps), relations(ps.size()),
+      chunks(4 * Workers::threads)
+    {
+      Workers::run(chunks, *this);
+    }
+  };
+
+  // The closest relation from each bitvector to any bitvector in
+  // another subgraph, where subgraph holds the representative of each
+  // bitvector's subgraph, and task n searches for bitvector n unless
+  // it is in subgraph skip.  Subgraphs only grow, so a relation in
+  // closest from an earlier search that still leads to another
+  // subgraph is still the closest, and is kept.
+  //
+  struct Outside
+  {
+    const vector<BitVector> &bitVectors;
+    const vector<int> &subgraph;
+    int skip;
+    vector<Relation> &closest;
+
+    // True unless bitvector n is skipped, or its closest relation
+    // still leads to another subgraph.
+    //
+    bool stale(size_t n) const {
+      const Relation &c = closest[n];
+      if (subgraph[n] == skip) return false;
+      return c.left < 0 || subgraph[c.left] == subgraph[c.right];
+    }
+
+    void operator()(size_t n) {
+      if (!stale(n)) return;
+      const vector<BitVector> &bvs = Replica::local(bitVectors);
+      const BitVector &bv = bvs[n];
+      Relation best(size_t(-1), -1, -1);
+      for (size_t i = 0; i < bvs.size(); ++i) {
+        if (subgraph[i] != subgraph[n]) {
+          const size_t nbd = BitVector::within(bv, bvs[i], best.nbd);
+          const Relation r(nbd, min(n, i), max(n, i));
+          if (r < best) best = r;
+        }
+      }
+      closest[n] = best;
+    }
+
+#ifdef BVG_GPU
+
+    // Find the stale closest relations on device instead.  Return
+    // false if the device fails.
+    //
+    bool onDevice() {
+      vector<int> wanted;
+      for (size_t n = 0; n < bitVectors.size(); ++n) {
+        if (stale(n)) wanted.push_back(n);
+      }
+      if (wanted.empty()) return true;
+      vector<uint64_t> keys(wanted.size());
+      if (!device->closest(&subgraph[0], &wanted[0], wanted.size(),
+                           BitVector::expected, &keys[0])) {
+        return false;
+      }
+      for (size_t k = 0; k < wanted.size(); ++k) {
+        const int n = wanted[k], i = keys[k] & 0xffffffff;
+        closest[n] = keys[k] == uint64_t(-1)
+          ? Relation(size_t(-1), -1, -1)
+          : Relation(keys[k] >> 32, min(n, i), max(n, i));
+      }
+      return true;
+    }
+
+#endif
+
+    Outside(const vector<BitVector> &bvs, const vector<int> &s, int k,
+            vector<Relation> &c):
+      bitVectors(bvs), subgraph(s), skip(k), closest(c)
+    {
+#ifdef BVG_GPU
+      if (device && onDevice()) return;
+#endif
+      Workers::run(bitVectors.size(), *this);
+    }
+  };
+
+  // Join each subgraph of forest, except the largest if skipLargest,
+  // to the subgraph closest to it, keeping what is known of the
+  // closest relation from each bitvector in closest.
+  //
+  void joinClosest(const vector<BitVector> &bitVectors, DisjointSet &forest,
+                   vector<Relation> &closest, bool skipLargest)
+  {
+    vector<int> subgraph(size), count(size, 0);
+    for (size_t n = 0; n < size; ++n) ++count[subgraph[n] = forest.find(n)];
+    const int largest = skipLargest
+      ? max_element(count.begin(), count.end()) - count.begin() : -1;
+    Stats::count("rounds", 1);
+    Outside(bitVectors, subgraph, largest, closest);
+    vector<Relation> best(size, Relation(size_t(-1), -1, -1));
+    for (size_t n = 0; n < size; ++n) {
+      const Relation &r = closest[n];
+      if (subgraph[n] != largest && r < best[subgraph[n]]) {
+        best[subgraph[n]] = r;
+      }
+    }
+    for (size_t n = 0; n < size; ++n) {
+      const Relation &r = best[n];
+      if (r.left >= 0 && forest.join(r.left, r.right)) result.add(r);
+    }
+  }
+
+  // Join the subgraphs of forest with exact searches until a single
+  // subgraph remains.  Each round joins every subgraph but the
+  // largest to the subgraph closest to it.
+  //
+  void stitch(const vector<BitVector> &bitVectors, DisjointSet &forest)
+  {
+    Stats::Phase phase("stitch");
+    vector<Relation> closest(size, Relation(size_t(-1), -1, -1));
+    while (forest.sets > 1) joinClosest(bitVectors, forest, closest, true);
+  }
+
+  // Start with every bitvector in a subgraph of its own, then in
+  // rounds, join every subgraph to the subgraph closest to it until
+  // a single subgraph remains.  The closest relations are found in
+  // parallel without storing any others, and ties are broken as
+  // Relations are ordered, so the result is the same as kruskal()'s.
+  //
+  void boruvka(const Population &population)
+  {
+    Stats::Phase phase("boruvka");
+    DisjointSet forest(size);
+    vector<Relation> closest(size, Relation(size_t(-1), -1, -1));
+    while (forest.sets > 1) {
+      joinClosest(population.bitVectors, forest, closest, false);
+    }
+  }
+
+  // Join the Candidates from hashing as kruskal() would, then stitch
+  // together whatever subgraphs remain.  The result spans all the
+  // bitvectors, but may miss some of the closest relations.
+  //
+  void approximate(const Population &population)
+  {
+    const vector<BitVector> &bitVectors = population.bitVectors;
+    if (size < 2) return;
+    vector<Relation> relations;
+    {
+      Stats::Phase phase("candidates");
+      Candidates candidates(bitVectors);
+      const vector<uint64_t> pairs(candidates.all());
+      Measure measure(bitVectors, pairs);
+      relations.swap(measure.relations);
+      Stats::count("relations", relations.size());
+    }
+    sortAll(relations);
+    DisjointSet forest(size);
+    join(relations, forest);
+    vector<Relation>().swap(relations);
+    stitch(bitVectors, forest);
+  }
+
+#ifdef BVG_MPI
+
+  // Note each relation of a tile in relations as it is found.
+  //
+  struct Listing
+  {
+    const vector<BitVector> &bitVectors;
+    vector<Relation> &relations;
+
+    void operator()(size_t i, size_t j, size_t count) {
+      relations.push_back(Relation(BitVector::normalize(count),
+                                   bitVectors[i].index, bitVectors[j].index));
+    }
+
+    Listing(const vector<BitVector> &bvs, vector<Relation> &rs):
+      bitVectors(bvs), relations(rs)
+    {}
+  };
+
+  // The tiles of bitVectors, cut as for findAll(), that fall to rank
+  // of ranks, where task n finds the relations of tile first + n and
+  // keeps only a spanning forest of them in kept[n].  Every other
+  // relation of the tile closes a cycle of closer relations, so it
+  // cannot be in the spanning graph either.
+  //
+  struct Shard
+  {
+    const vector<BitVector> &bitVectors;
+    size_t side;
+    vector<pair<size_t, size_t> > tiles;
+    size_t first;
+    vector<vector<Relation> > kept;
+
+    void operator()(size_t n) {
+      const size_t size = bitVectors.size();
+      const size_t top = tiles[first + n].first;
+      const size_t left = tiles[first + n].second;
+      vector<Relation> relations;
+      Listing listing(bitVectors, relations);
+      countTile(bitVectors, top, min(size, top + side),
+                left, min(size, left + side), false, listing);
+      sort(relations.begin(), relations.end());
+      const size_t columns = top == left ? 0 : side;
+      DisjointSet forest(2 * side);
+      kept[n].clear();
+      for (size_t k = 0; k < relations.size(); ++k) {
+        const Relation &r = relations[k];
+        if (forest.join(r.left - top, columns + r.right - left)) {
+          kept[n].push_back(r);
+        }
+      }
+    }
+
+    Shard(const vector<BitVector> &bvs, int rank, int ranks):
+      bitVectors(bvs),
+      side(max<size_t>(16, (256 << 10) / (8 * BitVector::stride))),
+      tiles(), first(0), kept()
+    {
+      const size_t size = bitVectors.size();
+      size_t n = 0;
+      for (size_t top = 0; top < size; top += side) {
+        for (size_t left = top; left < size; left += side) {
+          if (n++ % ranks == size_t(rank)) tiles.push_back(make_pair(top, left));
+        }
+      }
+    }
+  };
+
+  // Keep only a spanning forest of relations, which holds every one
+  // of them that can be in the spanning graph.
+  //
+  void prune(vector<Relation> &relations)
+  {
+    sortAll(relations, false);
+    DisjointSet forest(size);
+    vector<Relation> kept;
+    for (size_t n = 0; n < relations.size(); ++n) {
+      const Relation &r = relations[n];
+      if (forest.join(r.left, r.right)) kept.push_back(r);
+    }
+    relations.swap(kept);
+  }
 
-  friend size_t operator-(const BitVector &lhs, const BitVector &rhs)
+  // Find the relations of the Shard of rank of ranks a few tiles at a
+  // time, pruning those kept whenever they outnumber the bitvectors
+  // twice over, then gather what every rank kept at rank 0 to join
+  // as kruskal() would.  The result is empty on every other rank.
+  //
+  void distributed(const Population &population, int rank, int ranks)
   {
-    static const size_t expected = (SCALE * mutationPercentage / 100);
-    bitset<SCALE> difference(lhs.bits ^ rhs.bits);
-    const size_t distance = difference.count();
-    if (distance > expected) return distance - expected;
-    return expected - distance;
+    Stats::Phase sharding("shard");
+    Shard shard(population.bitVectors, rank, ranks);
+    vector<Relation> relations;
+    const size_t batch = 4 * Workers::threads;
+    for (; shard.first < shard.tiles.size(); shard.first += batch) {
+      const size_t count = min(batch, shard.tiles.size() - shard.first);
+      shard.kept.resize(count);
+      Workers::run(count, shard);
+      for (size_t n = 0; n < count; ++n) {
+        relations.insert(relations.end(),
+                         shard.kept[n].begin(), shard.kept[n].end());
+      }
+      if (relations.size() > 2 * size) prune(relations);
+    }
+    prune(relations);
+    sharding.end();
+    Stats::Phase gathering("gather");
+    vector<uint64_t> mine;
+    for (size_t n = 0; n < relations.size(); ++n) {
+      mine.push_back(relations[n].nbd);
+      mine.push_back(relations[n].left);
+      mine.push_back(relations[n].right);
+    }
+    int count = mine.size();
+    vector<int> counts(ranks), offsets(ranks);
+    MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int n = 1; n < ranks; ++n) offsets[n] = offsets[n - 1] + counts[n - 1];
+    vector<uint64_t> all(rank ? 0 : offsets[ranks - 1] + counts[ranks - 1]);
+    MPI_Gatherv(mine.empty() ? 0 : &mine[0], count, MPI_UINT64_T,
+                all.empty() ? 0 : &all[0], &counts[0], &offsets[0],
+                MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+    relations.resize(all.size() / 3);
+    for (size_t n = 0; n < relations.size(); ++n) {
+      relations[n] = Relation(all[3 * n], all[3 * n + 1], all[3 * n + 2]);
+    }
+    sortAll(relations, false);
+    join(relations);
   }
 
-  BitVector(): index(-1), bits() {}
-  BitVector(int n, const string &s): index(n), bits(s) {}
-};
+  // Find the spanning graph of population with ranks ranks of an MPI
+  // job, of which this is rank.  Only rank 0 has the result.
+  //
+  SpanningGraph(const Population &population, int rank, int ranks):
+    size(population.bitVectors.size()), result(), error()
+  {
+    distributed(population, rank, ranks);
+  }
 
+#endif
 
-// A population of BitVectors initialized from the stream s.
-// There is a problem with error on line when *this is false.
-//
-struct Population
-{
-  vector<BitVector> bitVectors;
-  int line;
-  string error;
+  // Return how many edges of this are not in that.
+  //
+  size_t differences(const SpanningGraph &that) const {
+    typedef vector<Relation>::const_iterator Rp;
+    vector<uint64_t> edges;
+    for (Rp pE = that.result.edges.begin(); pE != that.result.edges.end(); ++pE) {
+      edges.push_back(uint64_t(pE->left) << 32 | pE->right);
+    }
+    sort(edges.begin(), edges.end());
+    size_t result = 0;
+    for (Rp pE = this->result.edges.begin(); pE != this->result.edges.end(); ++pE) {
+      const uint64_t edge = uint64_t(pE->left) << 32 | pE->right;
+      if (!binary_search(edges.begin(), edges.end(), edge)) ++result;
+    }
+    return result;
+  }
 
-  operator bool() { return line == -1; }
+  // The ways to find a SpanningGraph: sort all relations and join
+  // subgraphs (KRUSKAL), or grow one tree without storing the
+  // relations (PRIM), or join subgraphs a few nbds at a time from
+  // raw distances (LAZY), or join only relations that hashing finds
+  // likely to be close (APPROXIMATE), or join every subgraph to its
+  // closest neighbor in rounds (BORUVKA).
+  //
+  enum Engine { KRUSKAL, PRIM, LAZY, APPROXIMATE, BORUVKA };
 
-  Population(istream &s): bitVectors(SCALE), line(-1), error()
+  // Find a graph spanning all the bitvectors in population that
+  // minimizes the normalized bit distances between bitvectors.
+  //
+  SpanningGraph(const Population &population, Engine engine):
+    size(population.bitVectors.size()), result(), error()
   {
-    string bitvector;
-    int n = 0;
-    for (; s && n < bitVectors.size(); ++n) {
-      if (getline(s, bitvector) && bitvector.size() == SCALE) {
-        bitVectors[n] = BitVector(n, bitvector);
-      } else {
-        break;
+    switch (engine) {
+    case KRUSKAL: kruskal(population); break;
+    case PRIM:    prim(population);    break;
+    case LAZY: {
+      DistanceMatrix matrix(population);
+      lazy(population, matrix);
+      break;
+    }
+    case APPROXIMATE: approximate(population); break;
+    case BORUVKA: boruvka(population); break;
+    }
+  }
+
+  // Find the graph as the LAZY engine does with the distances already
+  // in matrix, which were found while population was loaded.
+  //
+  SpanningGraph(const Population &population, DistanceMatrix &matrix):
+    size(population.bitVectors.size()), result(), error()
+  {
+    lazy(population, matrix);
+  }
+
+  // The relations of each bitvector from old on to every bitvector
+  // before it, where task n finds those of bitvector old + n and
+  // writes them to their place in relations after offset.
+  //
+  struct Appended
+  {
+    const vector<BitVector> &bitVectors;
+    size_t old;
+    vector<Relation> &relations;
+    size_t offset;
+
+    void operator()(size_t n) {
+      const size_t i = old + n;
+      const BitVector &rhs = bitVectors[i];
+      vector<Relation>::iterator op =
+        relations.begin() + offset + (i * (i - 1) - old * (old - 1)) / 2;
+      for (size_t j = 0; j < i; ++op, ++j) {
+        *op = Relation(bitVectors[j] - rhs, j, i);
       }
     }
-    if (n < bitVectors.size()) {
-      line = n; error = bitvector;
+
+    Appended(const vector<BitVector> &bvs, size_t o,
+             vector<Relation> &rs, size_t off):
+      bitVectors(bvs), old(o), relations(rs), offset(off) {}
+  };
+
+  // Extend previous, a graph spanning the first bitvectors of
+  // population, to a graph spanning them all.  No relation between
+  // two of the first bitvectors that is not in previous can be in
+  // the new graph, so only the relations of the bitvectors added
+  // since previous, and those in previous, need to be sorted.
+  //
+  SpanningGraph(const Population &population, const ConnectedGraph &previous):
+    size(population.bitVectors.size()), result(), error()
+  {
+    typedef vector<Relation>::const_iterator Rp;
+    const vector<BitVector> &bitVectors = population.bitVectors;
+    const size_t old = previous.vertexes.size();
+    if (old > size) return;
+    vector<Relation> relations(previous.edges.size()
+                               + (size * (size - 1) - old * (old - 1)) / 2);
+    vector<Relation>::iterator op = relations.begin();
+    for (Rp pE = previous.edges.begin(); pE != previous.edges.end(); ++pE) {
+      const BitVector &lhs = bitVectors[pE->left], &rhs = bitVectors[pE->right];
+      *op++ = Relation(lhs - rhs, pE->left, pE->right);
     }
+    Stats::Phase finding("relations");
+    Appended appended(bitVectors, old, relations, previous.edges.size());
+    Workers::run(size - old, appended);
+    Stats::count("relations", relations.size());
+    finding.end();
+    sortAll(relations, false);
+    join(relations);
   }
 };
 
 
-// Relation between two BitVectors, with indexes left and right, and
-// the normalized bit distance nbd between them.
+// From the undirected connected graph cg, extract a directed tree,
+// where result is a 0-based array such that result[n] is the parent
+// of child n and result[r] == -1 means that r is the root of the
+// tree.
 //
-struct Relation
-{
-  size_t nbd;
-  int left; int right;
+struct Genealogy {
+  typedef priority_queue<int, vector<int>, greater<int> > Leaves;
+  vector<int> result;
+  bool itsOk;
+
+  friend ostream &operator<<(ostream &s, const Genealogy &g) {
+    typedef vector<int>::const_iterator Pi;
+    for (Pi pI = g.result.begin(); pI != g.result.end(); ++pI) {
+      s << *pI << endl;
+    }
+    return s;
+  }
+
+  // True if this converged to a rooted tree.
+  //
+  operator bool() { return itsOk; }
 
-  // True if lhs is probably a closer relation than rhs.
+  // Trim the leaves (vertexes with only one neighbor) from cg in
+  // rounds, noting each leaf's parent in result as it is trimmed,
+  // until only one vertex is left.  Each round visits its leaves in
+  // index order.  A vertex left with one neighbor by trimming a leaf
+  // is trimmed later in the same round if its index is higher than
+  // the leaf's, and otherwise in the next round.
   //
-  friend bool operator<(const Relation &lhs, const Relation &rhs)
+  // Keep only the count of each vertex's neighbors in degree and the
+  // XOR of their indexes in others, so the parent of a leaf is just
+  // others[leaf], and keep the leaves of a round in a min-heap.
+  //
+  Genealogy(const ConnectedGraph &cg):
+    result(cg.vertexes.size(), -1), itsOk(true)
   {
-    return lhs.nbd < rhs.nbd;
+    typedef vector<Relation>::const_iterator Rp;
+    const size_t size = result.size();
+    vector<int> degree(size, 0);
+    vector<int> others(size, 0);
+    for (Rp pE = cg.edges.begin(); pE != cg.edges.end(); ++pE) {
+      ++degree[pE->left];  others[pE->left] ^= pE->right;
+      ++degree[pE->right]; others[pE->right] ^= pE->left;
+    }
+    size_t remaining = 0;
+    vector<int> next;
+    for (size_t n = 0; n < size; ++n) {
+      if (degree[n] > 0) ++remaining;
+      if (degree[n] == 1) next.push_back(n);
+    }
+    while (remaining > 1) {
+      itsOk = !next.empty();
+      if (!itsOk) break;
+      Leaves leaves(greater<int>(), next);
+      next.clear();
+      while (!leaves.empty()) {
+        const int child = leaves.top();
+        leaves.pop();
+        if (degree[child] != 1) continue;
+        const int parent = others[child];
+        result[child] = parent;
+        degree[child] = 0;
+        --remaining;
+        others[parent] ^= child;
+        if (--degree[parent] == 1) {
+          if (parent > child) {
+            leaves.push(parent);
+          } else {
+            next.push_back(parent);
+          }
+        }
+      }
+    }
   }
-
-  Relation(): nbd(0), left(0), right(0) {}
-  Relation(size_t d, int p, int c): nbd(d), left(p), right(c) {}
 };
 
 
-// A connected graph of Relations built while constructing a
-// SpanningGraph.
+
+// A synthetic population of count bitvectors of BitVector::size bits
+// grown as a random tree, where the first bitvector is random and
+// every other is a copy of its parent with each bit flipped with
+// probability mutationPercentage.  The parent of bitvector n is drawn
+// uniformly from the up to window bitvectors before it that are in
+// earlier batches, so all of a batch can be grown at once on Workers,
+// and only the last 2 * window bitvectors are ever kept, in ring.
+// Batches double in size from one up to window, so the tree is close
+// to a random recursive tree, with depth growing as the log of the
+// count for the first window bitvectors, and then by about two levels
+// for every window more.  Each bitvector is drawn
+// from its own Random seeded from seed and its index, so the same
+// seed grows the same population on any number of threads.
 //
-struct ConnectedGraph
+struct Generator
 {
-  set<int> vertexes;
-  vector<Relation> edges;
+  static const size_t window = 4096;
+  size_t count;
+  uint64_t seed;
+  vector<uint64_t> ring;
+  size_t first;
+  vector<int> parents;
+  vector<string> lines;
+  bool text;
 
-  // True if this graph contains all of the bitvectors.
+  // Return the words of bitvector n in ring.
   //
-  bool full() { return vertexes.size() >= SCALE; }
+  uint64_t *row(size_t n) {
+    return &ring[n % (2 * window) * BitVector::stride];
+  }
 
-  // Add e to this.
+  // Flip each of the bits at w with probability mutationPercentage,
+  // skipping from one bit flipped to the next by a gap drawn from the
+  // geometric distribution, rather than drawing for every bit.
   //
-  void add(const Relation &e) {
-    vertexes.insert(e.left);
-    vertexes.insert(e.right);
-    edges.push_back(e);
+  static void mutate(uint64_t *w, Random &random) {
+    const int percentage = BitVector::mutationPercentage;
+    if (percentage == 0) return;
+    if (percentage == 100) {
+      for (size_t k = 0; k < BitVector::stride; ++k) w[k] = ~w[k];
+      const size_t tail = BitVector::size % 64;
+      if (tail) w[BitVector::stride - 1] &= (uint64_t(1) << tail) - 1;
+      return;
+    }
+    const double scale = 1 / log1p(-percentage / 100.0);
+    for (size_t n = 0;; ++n) {
+      const double u = ((random() >> 11) + 1) * (1.0 / (uint64_t(1) << 53));
+      const double gap = floor(log(u) * scale);
+      if (gap >= double(BitVector::size - n)) return;
+      n += size_t(gap);
+      w[n / 64] ^= uint64_t(1) << (n % 64);
+    }
   }
 
-  // True if e connects to (has some vertex in common with) this.
-  // Otherwise false.
+  // Grow bitvector first + k from its parent, or at random if it is
+  // the first, and format it in lines[k] if text.
   //
-  bool connectsTo(const Relation &e) {
-    return vertexes.count(e.left) || vertexes.count(e.right);
+  void operator()(size_t k) {
+    const size_t n = first + k;
+    Random random(Random(seed * 0x9e3779b97f4a7c15ULL + n)());
+    uint64_t *const w = row(n);
+    if (n == 0) {
+      parents[k] = -1;
+      for (size_t b = 0; b < BitVector::size; b += 64) {
+        const size_t bits = min<size_t>(64, BitVector::size - b);
+        w[b / 64] = random();
+        if (bits < 64) w[b / 64] &= (uint64_t(1) << bits) - 1;
+      }
+    } else {
+      const size_t low = n > window ? n - window : 0;
+      const size_t parent = low + random() % (first - low);
+      parents[k] = parent;
+      const uint64_t *const p = row(parent);
+      copy(p, p + BitVector::stride, w);
+      mutate(w, random);
+    }
+    if (text) {
+      string &line = lines[k];
+      line.assign(BitVector::size, '0');
+      for (size_t b = 0; b < BitVector::size; ++b) {
+        if (w[b / 64] >> (b % 64) & 1) line[b] = '1';
+      }
+      line += '\n';
+    }
   }
 
-  // Merge that with this (when some new Edge connects two subgraphs).
+  // Write the population to genes, as a packed population file if
+  // packed, and the index of each bitvector's parent, or -1 for the
+  // first, to parents unless it is 0, one per line.  Return false
+  // if either cannot be written.
   //
-  void mergeWith(const ConnectedGraph &that) {
-    vertexes.insert(that.vertexes.begin(), that.vertexes.end());
-    edges.insert(edges.end(), that.edges.begin(), that.edges.end());
+  bool write(ostream &genes, ostream *parentsOut, bool packed) {
+    text = !packed;
+    if (packed) {
+      const PackedHeader h(BitVector::size, count,
+                           BitVector::mutationPercentage);
+      genes.write(reinterpret_cast<const char *>(&h), sizeof h);
+    }
+    for (first = 0; first < count && genes;) {
+      const size_t size = min(min(size_t(window), count - first),
+                              max<size_t>(first, 1));
+      parents.resize(size);
+      lines.resize(text ? size : 0);
+      Workers::run(size, *this);
+      for (size_t k = 0; k < size; ++k) {
+        if (text) {
+          genes << lines[k];
+        } else {
+          genes.write(reinterpret_cast<const char *>(row(first + k)),
+                      BitVector::stride * sizeof(uint64_t));
+        }
+        if (parentsOut) *parentsOut << parents[k] << '\n';
+      }
+      first += size;
+    }
+    return genes.flush() && (!parentsOut || parentsOut->flush());
   }
 
-  ConnectedGraph(): vertexes(), edges() {}
-  ConnectedGraph(const Relation &e): vertexes(), edges() {
-    add(e);
+  Generator(size_t c, size_t bits, uint64_t s):
+    count(c), seed(s), ring(), first(0), parents(), lines(), text(true)
+  {
+    BitVector::initialize(bits);
+    ring.resize(2 * window * BitVector::stride);
   }
 };
 
 
-// A undirected graph spanning all bitvectors and minimizing the
-// Relation distance between connected bitvectors.
+// The k bitvectors nearest by nbd to each of a batch of queries,
+// leaving out bitvector skip[q] (-1 for none) for query q.  Each of
+// chunks tasks scans one slice of bitVectors against every query in
+// the batch, keeping the k nearest it has seen for each query in a
+// max-heap of its own, so the tasks share nothing until their heaps
+// are merged into result, nearest first.  Once a heap is full, only
+// bitvectors within() its farthest nbd are counted out.  Neighbors
+// are ordered by nbd and then index, so the answer does not depend
+// on how bitVectors is sliced.
 //
-struct SpanningGraph
+struct Nearest
 {
-  typedef list<ConnectedGraph>::iterator Cp;
-  ConnectedGraph result;
+  typedef pair<size_t, int> Neighbor;
+  typedef priority_queue<Neighbor> Heap;
+  const vector<BitVector> &bitVectors;
+  const vector<BitVector> &queries;
+  const vector<int> &skip;
+  const size_t k;
+  size_t chunks;
+  vector<vector<Heap> > heaps;
+  vector<vector<Neighbor> > result;
 
-  // Merge any two subgraphs in connected joined by r.
+  // Keep neighbor in heap if it is among the k nearest so far.
   //
-  Cp merge(list<ConnectedGraph> &connected, Cp resultP, const Relation &r) {
-    for (Cp pC = connected.begin(); pC != connected.end(); ++pC) {
-      if (pC->connectsTo(r)) {
-        if (resultP == connected.end()) {
-          resultP = pC;
-        } else {
-          resultP->mergeWith(*pC);
-          connected.erase(pC);
-          break;
-        }
-      }
+  void keep(Heap &heap, const Neighbor &neighbor) {
+    if (heap.size() < k) {
+      heap.push(neighbor);
+    } else if (neighbor < heap.top()) {
+      heap.pop();
+      heap.push(neighbor);
     }
-    return resultP;
   }
 
-  // Add r to some subgraph.  Start a new subgraph if no connection
-  // was already found by merge().  Return true if graph at resultP
-  // spans all bitvectors.  Return false if the graph extraction
-  // should continue.
+  // Scan slice n of bitVectors against every query.
   //
-  bool add(list<ConnectedGraph> &connected, Cp resultP, const Relation &r) {
-    if (resultP == connected.end()) {
-      ConnectedGraph cg(r);
-      connected.push_back(cg);
-    } else {
-      resultP->add(r);
-      if (resultP->full()) return true;
+  void operator()(size_t n) {
+    const vector<BitVector> &bvs = Replica::local(bitVectors);
+    const size_t size = bvs.size();
+    const size_t end = size * (n + 1) / chunks;
+    vector<Heap> &heap = heaps[n];
+    for (size_t j = size * n / chunks; j < end; ++j) {
+      const BitVector &bv = bvs[j];
+      for (size_t q = 0; q < queries.size(); ++q) {
+        if (bv.index == skip[q]) continue;
+        const size_t bound = heap[q].size() < k ? size_t(-1)
+          : heap[q].top().first;
+        const size_t nbd = BitVector::within(queries[q], bv, bound);
+        if (nbd <= bound) keep(heap[q], Neighbor(nbd, bv.index));
+      }
     }
-    return false;
   }
 
-  // Return all the relations in population.
-  //
-  static vector<Relation> findAll(const Population &population)
+  Nearest(const vector<BitVector> &bvs, const vector<BitVector> &qs,
+          const vector<int> &s, size_t nearest):
+    bitVectors(bvs), queries(qs), skip(s), k(nearest),
+    chunks(min<size_t>(4 * Workers::threads, max<size_t>(1, bvs.size()))),
+    heaps(chunks, vector<Heap>(qs.size())), result(qs.size())
   {
-    const vector<BitVector> &bitVectors = population.bitVectors;
-    const size_t size = bitVectors.size();
-    typedef vector<BitVector>::const_iterator BvP;
-    vector<Relation> result(size * (size - 1) / 2);
-    vector<Relation>::iterator op = result.begin();
-    for (BvP lp = bitVectors.begin(); lp != bitVectors.end(); ++lp) {
-      for (BvP rp = lp + 1; rp < bitVectors.end(); ++op, ++rp) {
-        *op = Relation(*lp - *rp, lp->index, rp->index);
+    Workers::run(chunks, *this);
+    for (size_t q = 0; q < queries.size(); ++q) {
+      Heap &merged = heaps[0][q];
+      for (size_t n = 1; n < chunks; ++n) {
+        for (Heap &heap = heaps[n][q]; !heap.empty(); heap.pop()) {
+          keep(merged, heap.top());
+        }
+      }
+      result[q].resize(merged.size());
+      for (size_t m = merged.size(); m > 0; merged.pop()) {
+        result[q][--m] = merged.top();
       }
     }
-    return result;
   }
 
-  // *this is true when the result graph spans all the bitvectors.
-  // Otherwise false.
-  //
-  operator bool() { return result.vertexes.size() == SCALE; }
-
-  // Find a graph spanning all the bitvectors in relations that
-  // minimizes the normalized bit distances between bitvectors.
+  // Answer each line of in on out with the k bitvectors of population
+  // nearest to it, nearest first, as index:nbd separated by spaces.
+  // A line is either the index of a bitvector in population, to be
+  // left out of its own answer, or a bitvector of BitVector::size
+  // '0's and '1's.  Answer an empty line to any other, noting why on
+  // errs after cmd.  Queries are scanned in batches of all the lines
+  // waiting in in, up to batch of them, so a file of queries shares
+  // each pass over the population while a query typed at a terminal
+  // is answered at once.  Return the count of lines answered.
   //
-  SpanningGraph(const Population &population): result()
+  static size_t answer(const Population &population, size_t k,
+                       istream &in, ostream &out,
+                       ostream &errs, const char *cmd)
   {
-    typedef vector<Relation>::const_iterator Rp;
-    vector<Relation> relations(findAll(population));
-    sort(relations.begin(), relations.end());
-    list<ConnectedGraph> connected;
-    Cp resultP = connected.end();
-    for (Rp pR = relations.begin(); pR != relations.end(); ++pR) {
-      resultP = merge(connected, resultP, *pR);
-      if (add(connected, resultP, *pR)) break;
-      resultP = connected.end();
+    const size_t batch = 256;
+    const size_t size = population.bitVectors.size();
+    const size_t stride = BitVector::stride;
+    size_t answered = 0;
+    string line;
+    while (in.peek() != EOF) {
+      vector<string> lines;
+      while (lines.size() < batch && getline(in, line)) {
+        lines.push_back(line);
+        if (in.rdbuf()->in_avail() <= 0) break;
+      }
+      vector<uint64_t> words(lines.size() * stride, 0);
+      vector<BitVector> queries;
+      vector<int> skip;
+      vector<size_t> asked(lines.size(), size_t(-1));
+      for (size_t q = 0; q < lines.size(); ++q) {
+        const string &s = lines[q];
+        istringstream iss(s);
+        size_t n = 0;
+        uint64_t *const w = &words[q * stride];
+        if (s.size() == BitVector::size && BitVector::pack(w, s.data())) {
+          skip.push_back(-1);
+        } else if (iss >> n && iss.eof() && n < size) {
+          skip.push_back(n);
+          copy(population.bitVectors[n].bits,
+               population.bitVectors[n].bits + stride, w);
+        } else {
+          errs << cmd << ": Error: Query '" << s << "' is neither an"
+               << " index below " << size << " nor a bitvector of "
+               << BitVector::size << " bits." << endl;
+          continue;
+        }
+        asked[q] = queries.size();
+        queries.push_back(BitVector(-1, w));
+      }
+      const Nearest nearest(population.bitVectors, queries, skip, k);
+      for (size_t q = 0; q < lines.size(); ++q) {
+        if (asked[q] != size_t(-1)) {
+          const vector<Neighbor> &neighbors = nearest.result[asked[q]];
+          for (size_t m = 0; m < neighbors.size(); ++m) {
+            out << (m ? " " : "") << neighbors[m].second
+                << ':' << neighbors[m].first;
+          }
+        }
+        out << '\n';
+      }
+      if (!out.flush()) break;
+      answered += lines.size();
     }
-    if (resultP != connected.end()) result = *resultP;
+    return answered;
   }
 };
 
+vector<Stats::Entry> Stats::phases;
+vector<pair<string, uint64_t> > Stats::counters;
+vector<Stats::Phase *> Stats::open;
+bool Stats::resets = false;
+long Stats::summit = 0;
 
-// From the undirected connected graph cg, extract a directed tree,
-// where result is a 0-based array such that result[n] is the parent
-// of child n and result[r] == -1 means that r is the root of the
-// tree.
+size_t Workers::threads = max(1u, thread::hardware_concurrency());
+
+Numa::Placement Numa::placement = Numa::OFF;
+vector<vector<int> > Numa::nodes;
+thread_local int Numa::node = -1;
+vector<atomic<uint64_t> > Numa::tasks;
+vector<atomic<uint64_t> > Numa::busy;
+Replica *Replica::current = 0;
+
+SpanningGraph::Sorter SpanningGraph::sorter = SpanningGraph::COUNTING;
+SpanningGraph::Storage SpanningGraph::storage = SpanningGraph::WIDE;
+size_t SpanningGraph::hashTables = 128;
+size_t SpanningGraph::hashBits = 12;
+size_t SpanningGraph::memoryBudget = 0;
+const char *SpanningGraph::checkpoint = 0;
+double SpanningGraph::checkpointInterval = 300;
+bool SpanningGraph::resume = false;
+#ifdef BVG_GPU
+Device *SpanningGraph::device = 0;
+#endif
+
+int BitVector::mutationPercentage;
+BitVector::Kernel BitVector::kernel;
+BitVector::Tiling BitVector::tiling = BitVector::BLOCKED;
+size_t BitVector::size;
+size_t BitVector::stride;
+size_t BitVector::expected;
+size_t (*BitVector::count)(const uint64_t *, const uint64_t *);
+size_t (*BitVector::countChunk)(const uint64_t *, const uint64_t *);
+size_t (*BitVector::countTail)(const uint64_t *, const uint64_t *);
+void (*BitVector::countBlock)(const uint64_t *const *,
+                              const uint64_t *const *, size_t *);
+bool (*BitVector::pack)(uint64_t *, const char *);
+
+static bool initializeMutationPercentage(char *percentageString)
+{
+  istringstream issMp; issMp.str(percentageString);
+  return issMp >> BitVector::mutationPercentage
+    && BitVector::mutationPercentage >= 0
+    && BitVector::mutationPercentage <= 100;
+}
+
+// Set percentages to the comma-separated mutation percentages in
+// list, and set up for the first of them.  Return false unless each
+// is an integer from 0 to 100.
 //
-struct Genealogy {
-  typedef map<int, set<int> > Neighbors;
-  typedef Neighbors::iterator Np;
-  typedef vector<Np> Leaves;
-  typedef Leaves::iterator Pl;
-  vector<int> result;
-  bool itsOk;
+static bool initializeMutationPercentages(const char *list,
+                                          vector<int> &percentages)
+{
+  istringstream issList(list);
+  string item;
+  percentages.clear();
+  while (getline(issList, item, ',')) {
+    istringstream issMp(item);
+    int p = -1;
+    if (!(issMp >> p) || !issMp.eof() || p < 0 || p > 100) return false;
+    percentages.push_back(p);
+  }
+  if (percentages.empty()) return false;
+  BitVector::mutationPercentage = percentages[0];
+  return true;
+}
+
 
-  // Return a map of bitvector indexes to the indexes of their
-  // neighbors from the Relations in edges.
+// The command line options preceding the <prob> and <data> arguments,
+// which are left in args.  There is a problem with error when *this
+// is false.
+//
+struct Options
+{
+  SpanningGraph::Engine engine;
+  const char *convert;
+  const char *incremental;
+  const char *saveTree;
+  const char *stats;
+  const char *sweep;
+  size_t query;
+  size_t generate;
+  size_t bits;
+  size_t seed;
+  const char *parents;
+  bool packed;
+  bool validate;
+  vector<char *> args;
+  string error;
+
+  operator bool() { return error.empty(); }
+
+  // Set engine from its name in value.
   //
-  static Neighbors discover(const vector<Relation> &edges) {
-    typedef vector<Relation>::const_iterator Rp;
-    Neighbors result;
-    for (Rp pE = edges.begin(); pE != edges.end(); ++pE) {
-      result[pE->left].insert(pE->right);
-      result[pE->right].insert(pE->left);
+  void parseEngine(const string &value) {
+    if (value == "kruskal") {
+      engine = SpanningGraph::KRUSKAL;
+    } else if (value == "prim") {
+      engine = SpanningGraph::PRIM;
+    } else if (value == "lazy") {
+      engine = SpanningGraph::LAZY;
+    } else if (value == "approx") {
+      engine = SpanningGraph::APPROXIMATE;
+    } else if (value == "boruvka") {
+      engine = SpanningGraph::BORUVKA;
+    } else {
+      error = "Unknown engine '" + value + "'.";
     }
-    return result;
   }
 
-  // Remove all leaves from the map neighbors.  Return true if a leaf
-  // was removed from neighbors.  Otherwise return false.
+  // Set BitVector::kernel from its name in value.
   //
-  static bool trim(Neighbors &neighbors, Leaves &leaves) {
-    bool result = false;
-    for (Pl pL = leaves.begin(); pL != leaves.end(); ++pL) {
-      neighbors.erase(*pL);
-      result = true;
+  void parseKernel(const string &value) {
+    BitVector::Kernel k = BitVector::AUTO;
+    if (value == "auto") {
+      k = BitVector::AUTO;
+    } else if (value == "scalar") {
+      k = BitVector::SCALAR;
+    } else if (value == "avx2") {
+      k = BitVector::AVX2;
+    } else if (value == "avx512") {
+      k = BitVector::AVX512;
+    } else {
+      error = "Unknown kernel '" + value + "'.";
+      return;
     }
-    return result;
-  }
-
-  friend ostream &operator<<(ostream &s, const Genealogy &g) {
-    typedef vector<int>::const_iterator Pi;
-    for (Pi pI = g.result.begin(); pI != g.result.end(); ++pI) {
-      s << *pI << endl;
+    if (BitVector::supports(k)) {
+      BitVector::kernel = k;
+    } else {
+      error = "This processor cannot run the " + value + " kernel.";
     }
-    return s;
   }
 
-  // True if this converged to a rooted tree.
+  // Set count from its value for option, which must be from 1 to most.
   //
-  operator bool() { return itsOk; }
+  void parseCount(const string &option, const char *value,
+                  size_t &count, size_t most) {
+    istringstream iss(value);
+    size_t n = 0;
+    if (iss >> n && iss.eof() && n >= 1 && n <= most) {
+      count = n;
+    } else {
+      ostringstream oss; oss << most;
+      error = "Option '" + option + "' needs a positive integer"
+        + (most == size_t(-1) ? string() : " up to " + oss.str()) + ".";
+    }
+  }
 
-  // Extract neighborhoods from cg.  Find the leaves (vertexes with
-  // only one neighbor).  For each leaf, note its parent in result,
-  // remove it from its parent's neighborhood, then erase it from
-  // neighbors.  Consume neighbors until only one vertex is left.
-  //
-  Genealogy(const ConnectedGraph &cg): result(SCALE, -1)
+  Options(int ac, char *av[]):
+    engine(SpanningGraph::KRUSKAL), convert(0), incremental(0), saveTree(0),
+    stats(0), sweep(0), query(0), generate(0), bits(10000), seed(1),
+    parents(0),
+    packed(false),
+    validate(false), args(), error()
   {
-    Neighbors neighbors(discover(cg.edges));
-    while (neighbors.size() > 1) {
-      vector<Np> leaves;
-      for (Np pC = neighbors.begin(); pC != neighbors.end(); ++pC) {
-        if (pC->second.size() == 1) {
-          const size_t child = pC->first;
-          const size_t parent = *pC->second.begin();
-          result[child] = parent;
-          pC->second.erase(pC->second.begin());
-          leaves.push_back(pC);
-          neighbors.find(parent)->second.erase(child);
+    int n = 1;
+    for (; error.empty() && n < ac && string(av[n]).find("--") == 0; ++n) {
+      const string option(av[n]);
+      if (option == "--") { ++n; break; }
+      if (option == "--validate") {
+        validate = true;
+      } else if (option == "--packed") {
+        packed = true;
+      } else if (option == "--resume") {
+        SpanningGraph::resume = true;
+      } else if (n + 1 == ac) {
+        error = "Option '" + option + "' needs a value.";
+      } else if (option == "--convert") {
+        convert = av[++n];
+      } else if (option == "--incremental") {
+        incremental = av[++n];
+      } else if (option == "--save-tree") {
+        saveTree = av[++n];
+      } else if (option == "--stats") {
+        stats = av[++n];
+      } else if (option == "--sweep") {
+        sweep = av[++n];
+        if (!strchr(sweep, '%')) {
+          error = "Option '--sweep' needs a file name with a '%' in it.";
+        }
+      } else if (option == "--checkpoint") {
+        SpanningGraph::checkpoint = av[++n];
+      } else if (option == "--checkpoint-interval") {
+        istringstream iss(av[++n]);
+        double seconds = -1;
+        if (iss >> seconds && iss.eof() && seconds >= 0) {
+          SpanningGraph::checkpointInterval = seconds;
+        } else {
+          error = "Option '" + option + "' needs a count of seconds.";
+        }
+      } else if (option == "--query") {
+        parseCount(option, av[++n], query, size_t(-1));
+      } else if (option == "--generate") {
+        parseCount(option, av[++n], generate, size_t(INT_MAX));
+      } else if (option == "--bits") {
+        parseCount(option, av[++n], bits, size_t(INT_MAX));
+      } else if (option == "--seed") {
+        parseCount(option, av[++n], seed, size_t(-1));
+      } else if (option == "--parents") {
+        parents = av[++n];
+      } else if (option == "--engine") {
+        parseEngine(av[++n]);
+      } else if (option == "--kernel") {
+        parseKernel(av[++n]);
+      } else if (option == "--sort") {
+        const string value(av[++n]);
+        if (value == "counting") {
+          SpanningGraph::sorter = SpanningGraph::COUNTING;
+        } else if (value == "std") {
+          SpanningGraph::sorter = SpanningGraph::STANDARD;
+        } else {
+          error = "Unknown sort '" + value + "'.";
+        }
+      } else if (option == "--tiling") {
+        const string value(av[++n]);
+        if (value == "blocked") {
+          BitVector::tiling = BitVector::BLOCKED;
+        } else if (value == "naive") {
+          BitVector::tiling = BitVector::NAIVE;
+        } else {
+          error = "Unknown tiling '" + value + "'.";
+        }
+      } else if (option == "--numa") {
+        const string value(av[++n]);
+        if (value == "off") {
+          Numa::placement = Numa::OFF;
+        } else if (value == "pin") {
+          Numa::placement = Numa::PIN;
+        } else if (value == "replicate") {
+          Numa::placement = Numa::REPLICATE;
+        } else {
+          error = "Unknown NUMA placement '" + value + "'.";
+        }
+        if (Numa::placement != Numa::OFF && !Numa::supported()) {
+          error = "Option '--numa " + value
+            + "' is unsupported on this platform.";
+        }
+      } else if (option == "--relations") {
+        const string value(av[++n]);
+        if (value == "wide") {
+          SpanningGraph::storage = SpanningGraph::WIDE;
+        } else if (value == "compact") {
+          SpanningGraph::storage = SpanningGraph::COMPACT;
+        } else {
+          error = "Unknown relation storage '" + value + "'.";
         }
+      } else if (option == "--threads") {
+        parseCount(option, av[++n], Workers::threads, size_t(-1));
+      } else if (option == "--hash-tables") {
+        parseCount(option, av[++n], SpanningGraph::hashTables, size_t(-1));
+      } else if (option == "--hash-bits") {
+        parseCount(option, av[++n], SpanningGraph::hashBits, 32);
+      } else if (option == "--memory-budget") {
+        size_t megabytes = 0;
+        parseCount(option, av[++n], megabytes, size_t(-1) >> 20);
+        SpanningGraph::memoryBudget = megabytes << 20;
+      } else {
+        error = "Unknown option '" + option + "'.";
       }
-      itsOk = trim(neighbors, leaves);
-      if (!itsOk) break;
     }
+    if (error.empty() && SpanningGraph::resume && !SpanningGraph::checkpoint) {
+      error = "Option '--resume' needs '--checkpoint <file>'.";
+    } else if (error.empty() && SpanningGraph::checkpoint
+               && engine != SpanningGraph::LAZY) {
+      error = "Option '--checkpoint' needs '--engine lazy'.";
+    } else if (error.empty() && SpanningGraph::checkpoint && sweep) {
+      error = "Option '--checkpoint' cannot be used with '--sweep'.";
+    }
+    args.assign(av + n, av + ac);
   }
 };
 
+#ifdef BVG_MPI
 
-int BitVector::mutationPercentage;
-static bool initializeMutationPercentage(char *percentageString)
+// This process's rank among the ranks processes of an MPI job run
+// as bvg-mpi.  Rank 0 runs main() as bvg would, but shares the
+// population with the other ranks to find the spanning graph with
+// them, which is all the other ranks do.  Sharing nothing tells them
+// there is nothing to do, as does rank 0 leaving without sharing.
+//
+struct Cluster
 {
-  istringstream issMp; issMp.str(percentageString);
-  return issMp >> BitVector::mutationPercentage
-    && BitVector::mutationPercentage >= 0
-    && BitVector::mutationPercentage <= 100;
-}
+  int rank;
+  int ranks;
+  bool shared;
+
+  // Broadcast the n words at w from rank 0 in pieces MPI can count.
+  //
+  static void broadcast(uint64_t *w, size_t n) {
+    const size_t most = size_t(1) << 27;
+    for (size_t k = 0; k < n; k += most) {
+      MPI_Bcast(w + k, min(most, n - k), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    }
+  }
+
+  // Share the bits, count and mutation percentage of population,
+  // or of nothing if population is 0.
+  //
+  void share(const Population *population) {
+    const size_t count = population ? population->bitVectors.size() : 0;
+    uint64_t header[3] = { BitVector::size, count,
+                           uint64_t(BitVector::mutationPercentage) };
+    MPI_Bcast(header, 3, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (count) {
+      broadcast(const_cast<uint64_t *>(population->bitVectors[0].bits),
+                count * BitVector::stride);
+    }
+    shared = true;
+  }
+
+  // Receive what rank 0 shares, and help find its spanning graph.
+  //
+  void serve() {
+    uint64_t header[3];
+    MPI_Bcast(header, 3, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (header[1] == 0) return;
+    BitVector::mutationPercentage = header[2];
+    vector<uint64_t> words(header[1] * ((header[0] + 63) / 64));
+    broadcast(&words[0], words.size());
+    const Population population(header[0], header[1], words);
+    SpanningGraph(population, rank, ranks);
+  }
+
+  Cluster(int *ac, char ***av): rank(0), ranks(1), shared(false)
+  {
+    MPI_Init(ac, av);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+  }
+
+  ~Cluster()
+  {
+    if (rank == 0 && !shared) share(0);
+    MPI_Finalize();
+  }
+};
+
+#endif
+
+// bvg-bench.cc includes this file for everything but main().
+//
+#ifndef BVG_BENCH
 
 int main(int ac, char *av[])
 {
-  if (ac == 3) {
-    if (initializeMutationPercentage(av[1])) {
-      ifstream dataStream(av[2]);
-      Population population(dataStream);
+#ifdef BVG_MPI
+  Cluster cluster(&ac, &av);
+#endif
+  Options options(ac, av);
+#ifdef BVG_MPI
+  if (cluster.rank != 0) {
+    cluster.serve();
+    return 0;
+  }
+#endif
+  // Let cin buffer on its own, so Nearest::answer() can see how many
+  // queries are waiting.
+  //
+  if (options.query) ios::sync_with_stdio(false);
+  if (Numa::placement != Numa::OFF) Numa::discover();
+  const Stats::Report report(options.stats);
+  if (!options) {
+    cerr << av[0] << ": Error: " << options.error << endl;
+  } else if (options.args.size() == 2 && options.generate
+             && initializeMutationPercentage(options.args[0])) {
+    const Stats::Phase phase("generate");
+    Generator generator(options.generate, options.bits, options.seed);
+    ofstream genes(options.args[1], ios::binary);
+    ofstream parents;
+    if (options.parents) parents.open(options.parents);
+    if (generator.write(genes, options.parents ? &parents : 0,
+                        options.packed)) {
+      return 0;
+    }
+    cerr << av[0] << ": Error: Cannot write '" << options.args[1] << "'"
+         << (options.parents ? string(" or '") + options.parents + "'" : "")
+         << "." << endl;
+  } else if (options.args.size() == 2 && options.sweep) {
+    vector<int> percentages;
+    if (initializeMutationPercentages(options.args[0], percentages)) {
+      Stats::Phase loading("load");
+      Population population;
+      DistanceMatrix matrix(population);
+      population.load(options.args[1], &matrix);
+      loading.end();
+      Stats::count("bitvectors", population.bitVectors.size());
+      Stats::count("bits", BitVector::size);
+      Stats::count("threads", Workers::threads);
+      Stats::count("percentages", percentages.size());
       if (population) {
-        SpanningGraph graph(population);
+        const Replica replica(population.bitVectors);
+        const string pattern(options.sweep);
+        const size_t at = pattern.find('%');
+        bool ok = true;
+        for (size_t n = 0; ok && n < percentages.size(); ++n) {
+          ostringstream oss; oss << percentages[n];
+          const string path = string(pattern).replace(at, 1, oss.str());
+          BitVector::reset(percentages[n]);
+          SpanningGraph graph(population, matrix);
+          ok = graph;
+          if (ok) {
+            Stats::count("edges", graph.result.edges.size());
+            Stats::Phase orienting("genealogy");
+            Genealogy genealogy(graph.result);
+            orienting.end();
+            ok = genealogy;
+            if (ok) {
+              const Stats::Phase writing("output");
+              ofstream output(path.c_str());
+              if (!(output << genealogy).flush()) {
+                ok = false;
+                cerr << av[0] << ": Error: Cannot write '" << path << "'."
+                     << endl;
+              }
+            } else {
+              cerr << av[0] << ": Error: The genealogy for " << percentages[n]
+                   << "% did not converge." << endl;
+            }
+          } else if (graph.error.empty()) {
+            cerr << av[0] << ": Error: Cannot relate entire population."
+                 << endl;
+          } else {
+            cerr << av[0] << ": Error: " << graph.error << endl;
+          }
+        }
+        if (ok) return 0;
+      } else {
+        cerr << av[0] << ": Error on line " << population.line
+             << ": " << population.error << endl;
+      }
+    } else {
+      cerr << av[0] << ": Error: First argument '" << options.args[0]
+           << "' should be a list of integers between 0 and 100." << endl;
+    }
+  } else if (options.args.size() == 2) {
+    if (initializeMutationPercentage(options.args[0])) {
+      const bool overlap = options.engine == SpanningGraph::LAZY
+        && !options.incremental && !options.convert && !options.query
+        && !SpanningGraph::resume;
+      Stats::Phase loading("load");
+      Population population;
+      DistanceMatrix matrix(population);
+      population.load(options.args[1], overlap ? &matrix : 0);
+      loading.end();
+      Stats::count("bitvectors", population.bitVectors.size());
+      Stats::count("bits", BitVector::size);
+      Stats::count("threads", Workers::threads);
+      ConnectedGraph previous;
+      TreeHeader header;
+      ifstream tree;
+      if (options.incremental) {
+        tree.open(options.incremental);
+        tree >> header >> previous;
+      }
+      if (population && options.convert) {
+        ofstream packed(options.convert, ios::binary);
+        if (population.pack(packed, BitVector::mutationPercentage)) return 0;
+        cerr << av[0] << ": Error: Cannot write '" << options.convert
+             << "'." << endl;
+      } else if (population && options.query) {
+        const Replica replica(population.bitVectors);
+        const Stats::Phase phase("query");
+        const size_t answered = Nearest::answer(population, options.query,
+                                                cin, cout, cerr, av[0]);
+        Stats::count("queries", answered);
+        if (cout) return 0;
+        cerr << av[0] << ": Error: Cannot write answers." << endl;
+      } else if (population && options.incremental
+                 && (!tree || previous.vertexes.size()
+                     > population.bitVectors.size())) {
+        cerr << av[0] << ": Error: Cannot read a spanning graph of at most "
+             << population.bitVectors.size() << " bitvectors from '"
+             << options.incremental << "'." << endl;
+      } else if (population && options.incremental
+                 && !(header == TreeHeader(population.bitVectors,
+                                           previous.vertexes.size()))) {
+        cerr << av[0] << ": Error: The spanning graph in '"
+             << options.incremental << "' was not found from the first "
+             << previous.vertexes.size() << " bitvectors of '"
+             << options.args[1] << "' with " << BitVector::mutationPercentage
+             << "% mutation." << endl;
+      } else if (population) {
+        const Replica replica(population.bitVectors);
+#ifdef BVG_GPU
+        const bool offload = !options.incremental
+          && (options.engine == SpanningGraph::BORUVKA
+              || options.engine == SpanningGraph::APPROXIMATE);
+        Device device(population.bitVectors[0].bits,
+                      offload ? population.bitVectors.size() : 0,
+                      BitVector::stride);
+        if (device) SpanningGraph::device = &device;
+#endif
+#ifdef BVG_MPI
+        if (cluster.ranks > 1 && !options.incremental
+            && options.engine == SpanningGraph::KRUSKAL) {
+          cluster.share(&population);
+        }
+#endif
+        SpanningGraph graph = options.incremental
+          ? SpanningGraph(population, previous)
+#ifdef BVG_MPI
+          : cluster.shared ? SpanningGraph(population, 0, cluster.ranks)
+#endif
+          : overlap ? SpanningGraph(population, matrix)
+          : SpanningGraph(population, options.engine);
+        if (graph && options.saveTree) {
+          ofstream tree(options.saveTree);
+          const TreeHeader saved(population.bitVectors,
+                                 population.bitVectors.size());
+          if (!(tree << saved << graph.result).flush()) {
+            cerr << av[0] << ": Error: Cannot write '" << options.saveTree
+                 << "'." << endl;
+            return 1;
+          }
+        }
+        if (graph && options.validate) {
+          const SpanningGraph exact(population, SpanningGraph::KRUSKAL);
+          cerr << av[0] << ": " << graph.differences(exact) << " of "
+               << graph.result.edges.size() << " edges differ from the "
+               << "exact spanning graph, with a total nbd of "
+               << graph.result.total() << " instead of "
+               << exact.result.total() << "." << endl;
+        }
         if (graph) {
+          Stats::count("edges", graph.result.edges.size());
+          Stats::Phase orienting("genealogy");
           Genealogy genealogy(graph.result);
+          orienting.end();
           if (genealogy) {
-            cout << genealogy;
+            const Stats::Phase writing("output");
+            cout << genealogy << flush;
             return 0;
           } else {
             cerr << av[0] << ": Error: The genealogy did not converge." << endl;
           }
-        } else {
+        } else if (graph.error.empty()) {
           cerr << av[0] << ": Error: Cannot relate entire population." << endl;
+        } else {
+          cerr << av[0] << ": Error: " << graph.error << endl;
         }
       } else {
         cerr << av[0] << ": Error on line " << population.line
              << ": " << population.error << endl;
       }
     } else {
-      cerr << av[0] << ": Error: First argument '" << av[1]
+      cerr << av[0] << ": Error: First argument '" << options.args[0]
            << "' should be an integer between 0 and 100." << endl;
     }
   }
   showUsage(cerr, av[0]);
   return 1;
 }
+
+#endif